@@ -1 +1,7 @@
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)  # for reverse-ad-demo::parallel
+if(@reverse-ad-demo_USE_UNORDERED_DENSE@)
+  find_dependency(unordered_dense CONFIG)
+endif()
+
 include("${CMAKE_CURRENT_LIST_DIR}/reverse-ad-demoTargets.cmake")
@@ -5,7 +5,7 @@ if(PROJECT_IS_TOP_LEVEL)
   )
 endif()
 
-# Project is configured with no languages, so tell GNUInstallDirs the lib dir
+# Header-only package: keep GNUInstallDirs on lib instead of a platform lib64
 set(CMAKE_INSTALL_LIBDIR lib CACHE PATH "")
 
 include(CMakePackageConfigHelpers)
@@ -21,7 +21,7 @@ install(
 )
 
 install(
-    TARGETS reverse-ad-demo_reverse-ad-demo
+    TARGETS reverse-ad-demo_reverse-ad-demo reverse-ad-demo_parallel
     EXPORT reverse-ad-demoTargets
     INCLUDES DESTINATION "${CMAKE_INSTALL_INCLUDEDIR}"
 )
@@ -39,10 +39,15 @@ set(
 )
 mark_as_advanced(reverse-ad-demo_INSTALL_CMAKEDIR)
 
+# the config carries the optional dependencies this build was configured with
+configure_file(
+    cmake/install-config.cmake "${package}Config.cmake"
+    @ONLY
+)
+
 install(
-    FILES cmake/install-config.cmake
+    FILES "${PROJECT_BINARY_DIR}/${package}Config.cmake"
     DESTINATION "${reverse-ad-demo_INSTALL_CMAKEDIR}"
-    RENAME "${package}Config.cmake"
     COMPONENT reverse-ad-demo_Development
 )
 
@@ -0,0 +1,186 @@
+#ifndef REVERSE_AD_DEMO_BATCH_HPP
+#define REVERSE_AD_DEMO_BATCH_HPP
+
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dual.hpp"
+#include "kernels.hpp"
+
+namespace forward
+{
+
+// forward mode over a whole data column: a holds the values and b the
+// directional derivatives at every one of the points, stored as separate
+// contiguous arrays. each operator is a single loop over the points, so
+// compilers vectorize it and one evaluation of a model yields all residuals
+// and one jacobian column. duals and plain numbers (e.g. parameters) are
+// broadcast to every point. operators write into the storage of a batch
+// argument passed by value, so a temporary operand is reused in place. an
+// lvalue operand (such as x in x * x) is copied first, with the allocator of
+// the original: give the data column a pool (see pmr::batch) and every column
+// of an evaluation is recycled from the previous one
+template<typename T = double, typename Allocator = std::allocator<T>>
+struct batch
+{
+    using Scalar = T;
+    using Column = std::vector<T, Allocator>;
+
+    Column a;
+    Column b;
+
+    batch() = default;
+    batch(Column values, Column tangents)
+        : a {std::move(values)}
+        , b {std::move(tangents)}
+    {
+    }
+
+    // unlike std::vector, a copy keeps the allocator of the original
+    batch(batch const& other)
+        : a {other.a, other.a.get_allocator()}
+        , b {other.b, other.b.get_allocator()}
+    {
+    }
+    batch(batch&&) noexcept = default;
+    auto operator=(batch const&) -> batch& = default;
+    auto operator=(batch&&) -> batch& = default;
+    ~batch() = default;
+
+    // data column with a zero tangent
+    static auto constant(std::span<T const> x, Allocator const& allocator = {}) -> batch
+    {
+        return {Column(x.begin(), x.end(), allocator), Column(std::size(x), T {0}, allocator)};
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return std::size(a); }
+
+    // operands that are broadcast to every point
+    template<typename X>
+    static constexpr bool broadcast = Number<X> || std::same_as<X, basic_dual<T>>;
+
+    friend auto operator+(batch x, batch const& y) -> batch { return zip(std::move(x), y, std::plus {}); }
+    friend auto operator-(batch x, batch const& y) -> batch { return zip(std::move(x), y, std::minus {}); }
+    friend auto operator*(batch x, batch const& y) -> batch { return zip(std::move(x), y, std::multiplies {}); }
+    friend auto operator/(batch x, batch const& y) -> batch { return zip(std::move(x), y, std::divides {}); }
+
+    template<typename X>
+        requires broadcast<X>
+    friend auto operator+(batch x, X const& y) -> batch
+    {
+        return zip(std::move(x), y, std::plus {});
+    }
+    template<typename X>
+        requires broadcast<X>
+    friend auto operator-(batch x, X const& y) -> batch
+    {
+        return zip(std::move(x), y, std::minus {});
+    }
+    template<typename X>
+        requires broadcast<X>
+    friend auto operator*(batch x, X const& y) -> batch
+    {
+        return zip(std::move(x), y, std::multiplies {});
+    }
+    template<typename X>
+        requires broadcast<X>
+    friend auto operator/(batch x, X const& y) -> batch
+    {
+        return zip(std::move(x), y, std::divides {});
+    }
+
+    template<typename X>
+        requires broadcast<X>
+    friend auto operator+(X const& x, batch y) -> batch
+    {
+        return zip(std::move(y), x, [](auto const& p, auto const& q) { return q + p; });
+    }
+    template<typename X>
+        requires broadcast<X>
+    friend auto operator-(X const& x, batch y) -> batch
+    {
+        return zip(std::move(y), x, [](auto const& p, auto const& q) { return q - p; });
+    }
+    template<typename X>
+        requires broadcast<X>
+    friend auto operator*(X const& x, batch y) -> batch
+    {
+        return zip(std::move(y), x, [](auto const& p, auto const& q) { return q * p; });
+    }
+    template<typename X>
+        requires broadcast<X>
+    friend auto operator/(X const& x, batch y) -> batch
+    {
+        return zip(std::move(y), x, [](auto const& p, auto const& q) { return q / p; });
+    }
+
+    friend auto operator-(batch x) -> batch
+    {
+        for (auto i = 0UL; i < x.size(); ++i) {
+            x.a[i] = -x.a[i];
+            x.b[i] = -x.b[i];
+        }
+        return x;
+    }
+
+    friend auto sin(batch x) -> batch { return chain(std::move(x), [](T const& v) { return kernel::sin(v); }); }
+    friend auto cos(batch x) -> batch { return chain(std::move(x), [](T const& v) { return kernel::cos(v); }); }
+    friend auto exp(batch x) -> batch { return chain(std::move(x), [](T const& v) { return kernel::exp(v); }); }
+    friend auto log(batch x) -> batch { return chain(std::move(x), [](T const& v) { return kernel::log(v); }); }
+
+    [[nodiscard]] auto sin() const -> batch { return chain(*this, [](T const& v) { return kernel::sin(v); }); }
+    [[nodiscard]] auto cos() const -> batch { return chain(*this, [](T const& v) { return kernel::cos(v); }); }
+    [[nodiscard]] auto exp() const -> batch { return chain(*this, [](T const& v) { return kernel::exp(v); }); }
+    [[nodiscard]] auto log() const -> batch { return chain(*this, [](T const& v) { return kernel::log(v); }); }
+
+  private:
+    // point i of an operand as a scalar dual
+    static auto at(batch const& x, std::size_t i) -> basic_dual<T> { return {.a = x.a[i], .b = x.b[i]}; }
+    static auto at(basic_dual<T> const& x, std::size_t /*unused*/) -> basic_dual<T> { return x; }
+    static auto at(Number auto x, std::size_t /*unused*/) -> basic_dual<T> { return basic_dual<T> {T(x)}; }
+
+    // r[i] = f(r[i], y[i]) with the scalar dual rules, in place
+    template<typename Y, typename F>
+    static auto zip(batch r, Y const& y, F f) -> batch
+    {
+        if constexpr (std::same_as<Y, batch>) {
+            assert(y.size() == r.size());
+        }
+        for (auto i = 0UL; i < r.size(); ++i) {
+            auto const d = f(at(r, i), at(y, i));
+            r.a[i] = d.a;
+            r.b[i] = d.b;
+        }
+        return r;
+    }
+
+    // chain rule on a fused value/derivative kernel, in place
+    template<typename F>
+    static auto chain(batch x, F f) -> batch
+    {
+        for (auto i = 0UL; i < x.size(); ++i) {
+            auto const [v, d] = f(x.a[i]);
+            x.a[i] = v;
+            x.b[i] *= d;
+        }
+        return x;
+    }
+};
+
+namespace pmr
+{
+// batch whose columns come from a std::pmr::memory_resource, e.g. a
+// std::pmr::unsynchronized_pool_resource that outlives the evaluations
+template<typename T = double>
+using batch = forward::batch<T, std::pmr::polymorphic_allocator<T>>;
+}  // namespace pmr
+}  // namespace forward
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef REVERSE_AD_DEMO_BFLOAT16_HPP
+#define REVERSE_AD_DEMO_BFLOAT16_HPP
+
+#include <bit>
+#include <cstdint>
+
+namespace reverse
+{
+
+// brain floating point storage type: the upper 16 bits of an IEEE float, i.e.
+// the full float exponent range with 8 significant bits. it is meant for
+// storing tape partials (see Tape's storage parameter): values are rounded to
+// nearest even on construction and all arithmetic happens in float after the
+// implicit conversion
+struct bfloat16
+{
+    constexpr bfloat16() = default;
+
+    constexpr bfloat16(double x)  // NOLINT(google-explicit-constructor)
+        : bits(round(static_cast<float>(x)))
+    {
+    }
+
+    constexpr operator float() const  // NOLINT(google-explicit-constructor)
+    {
+        return std::bit_cast<float>(static_cast<std::uint32_t>(static_cast<std::uint32_t>(bits) << 16U));
+    }
+
+    std::uint16_t bits {0};
+
+  private:
+    static constexpr auto round(float f) -> std::uint16_t
+    {
+        auto const u = std::bit_cast<std::uint32_t>(f);
+        if ((u & 0x7fffffffU) > 0x7f800000U) {
+            return static_cast<std::uint16_t>((u >> 16U) | 0x40U);  // keep nan quiet
+        }
+        auto const lsb = (u >> 16U) & 1U;
+        return static_cast<std::uint16_t>((u + 0x7fffU + lsb) >> 16U);
+    }
+};
+
+}  // namespace reverse
+
+#endif
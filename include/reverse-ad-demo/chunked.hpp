@@ -0,0 +1,141 @@
+#ifndef REVERSE_AD_DEMO_CHUNKED_HPP
+#define REVERSE_AD_DEMO_CHUNKED_HPP
+
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace reverse
+{
+
+// append-only array made of fixed-size blocks obtained from an allocator
+// - push_back is O(1) and growing never copies existing elements
+// - element addresses remain stable until the element is removed
+// - resize() keeps the blocks around for reuse, clear() returns all of them
+template<typename U, typename Alloc = std::allocator<U>, std::size_t BlockSize = 4096>
+class ChunkedArray
+{
+    static_assert(std::has_single_bit(BlockSize), "block size must be a power of two");
+
+    using traits = typename std::allocator_traits<Alloc>::template rebind_traits<U>;
+    using table_allocator = typename traits::template rebind_alloc<U*>;
+
+    static constexpr auto shift {std::countr_zero(BlockSize)};
+    static constexpr auto mask {BlockSize - 1};
+
+  public:
+    using value_type = U;
+    using allocator_type = typename traits::allocator_type;
+
+    static constexpr std::size_t block_size {BlockSize};
+
+    ChunkedArray()
+        : ChunkedArray(allocator_type {})
+    {
+    }
+
+    explicit ChunkedArray(allocator_type const& alloc)
+        : alloc_(alloc)
+        , blocks_(table_allocator(alloc))
+    {
+    }
+
+    ChunkedArray(ChunkedArray const& other)
+        : ChunkedArray(traits::select_on_container_copy_construction(other.alloc_))
+    {
+        append(other);
+    }
+
+    ChunkedArray(ChunkedArray&& other) noexcept
+        : alloc_(std::move(other.alloc_))
+        , blocks_(std::move(other.blocks_))
+        , size_(std::exchange(other.size_, 0))
+    {
+    }
+
+    auto operator=(ChunkedArray const& other) -> ChunkedArray&
+    {
+        if (this != &other) {
+            resize(0);
+            append(other);
+        }
+        return *this;
+    }
+
+    auto operator=(ChunkedArray&& other) -> ChunkedArray&
+    {
+        if (this == &other) {
+            return *this;
+        }
+        if (alloc_ == other.alloc_) {
+            clear();
+            blocks_ = std::move(other.blocks_);
+            size_ = std::exchange(other.size_, 0);
+        } else {
+            // blocks owned by a different memory resource cannot be adopted
+            resize(0);
+            append(other);
+            other.clear();
+        }
+        return *this;
+    }
+
+    ~ChunkedArray() { clear(); }
+
+    auto push_back(U const& value) -> void
+    {
+        if (size_ == capacity()) {
+            blocks_.push_back(traits::allocate(alloc_, BlockSize));
+        }
+        traits::construct(alloc_, &(*this)[size_], value);
+        ++size_;
+    }
+
+    auto resize(std::size_t n, U const& value = U {}) -> void
+    {
+        for (; size_ > n; --size_) {
+            traits::destroy(alloc_, &(*this)[size_ - 1]);
+        }
+        while (size_ < n) {
+            push_back(value);
+        }
+    }
+
+    // destroys all elements and returns every block to the allocator at once
+    auto clear() -> void
+    {
+        resize(0);
+        for (auto* block : blocks_) {
+            traits::deallocate(alloc_, block, BlockSize);
+        }
+        blocks_.clear();
+        blocks_.shrink_to_fit();
+    }
+
+    auto operator[](std::size_t i) -> U& { return blocks_[i >> shift][i & mask]; }
+    auto operator[](std::size_t i) const -> U const& { return blocks_[i >> shift][i & mask]; }
+
+    [[nodiscard]] auto size() const -> std::size_t { return size_; }
+    [[nodiscard]] auto empty() const -> bool { return size_ == 0; }
+    [[nodiscard]] auto capacity() const -> std::size_t { return std::size(blocks_) * BlockSize; }
+    [[nodiscard]] auto block_count() const -> std::size_t { return std::size(blocks_); }
+    [[nodiscard]] auto get_allocator() const -> allocator_type { return alloc_; }
+
+  private:
+    auto append(ChunkedArray const& other) -> void
+    {
+        for (auto i = 0UL; i < other.size(); ++i) {
+            push_back(other[i]);
+        }
+    }
+
+    [[no_unique_address]] allocator_type alloc_;
+    std::vector<U*, table_allocator> blocks_;
+    std::size_t size_ {0};
+};
+
+}  // namespace reverse
+
+#endif
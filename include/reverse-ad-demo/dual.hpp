@@ -3,86 +3,113 @@
 
 #include <cmath>
 #include <concepts>
+#include <cstddef>
 #include <tuple>
+#include <type_traits>
+
+#include "kernels.hpp"
+#include "simd.hpp"
 
 namespace forward
 {
-struct dual
+
+// plain numbers that mix with duals as constants
+template<typename X>
+concept Number = std::is_arithmetic_v<X>;
+
+// dual number with N tangent lanes: a is the value and b holds N directional
+// derivatives. with N = 1 the tangent is a plain T, otherwise it is a SIMD pack,
+// so seeding lane i with the i-th unit vector yields a whole gradient (or one
+// Jacobian row per output) from a single evaluation. everything is constexpr,
+// so derivatives of constant inputs can be computed (and checked) at compile time
+template<typename T = double, std::size_t N = 1>
+struct basic_dual
 {
-    double a {0};
-    double b {0};
+    using Scalar = T;
+    using Tangent = std::conditional_t<N == 1, T, simd::pack<T, N>>;
 
-    auto operator*() const -> std::tuple<double, double> { return {a, b}; }
+    static constexpr std::size_t lanes {N};
 
-    friend auto operator+(dual const& lhs, dual const& rhs) -> dual
+    T a {0};
+    Tangent b {0};
+
+    // independent variable with value x and a unit tangent in lane i
+    static constexpr auto variable(T x, std::size_t i) -> basic_dual
+    {
+        basic_dual d {x};
+        if constexpr (N == 1) {
+            d.b = T {1};
+        } else {
+            d.b[i] = T {1};
+        }
+        return d;
+    }
+
+    constexpr auto operator*() const -> std::tuple<T, Tangent> { return {a, b}; }
+
+    friend constexpr auto operator+(basic_dual const& lhs, basic_dual const& rhs) -> basic_dual
     {
         auto const [a, b] = *lhs;
         auto const [c, d] = *rhs;
         return {.a = a + c, .b = b + d};
     }
-    friend auto operator+(std::floating_point auto x, dual const& a) { return dual {x} + a; }
-    friend auto operator+(dual const& a, std::floating_point auto x) { return a + dual {x}; }
+    friend constexpr auto operator+(Number auto x, basic_dual const& a) { return basic_dual {T(x)} + a; }
+    friend constexpr auto operator+(basic_dual const& a, Number auto x) { return a + basic_dual {T(x)}; }
 
-    auto operator+=(dual const& other) -> dual&
+    constexpr auto operator+=(basic_dual const& other) -> basic_dual&
     {
         auto tmp = *this + other;
         std::swap(*this, tmp);
         return *this;
     }
 
-    friend auto operator-(dual const& lhs, dual const& rhs) -> dual
+    friend constexpr auto operator-(basic_dual const& lhs, basic_dual const& rhs) -> basic_dual
     {
         auto const [a, b] = *lhs;
         auto const [c, d] = *rhs;
         return {.a = a - c, .b = b - d};
     }
-    friend auto operator-(std::floating_point auto x, dual const& a) { return dual {x} - a; }
-    friend auto operator-(dual const& a, std::floating_point auto x) { return a - dual {x}; }
+    friend constexpr auto operator-(Number auto x, basic_dual const& a) { return basic_dual {T(x)} - a; }
+    friend constexpr auto operator-(basic_dual const& a, Number auto x) { return a - basic_dual {T(x)}; }
 
-    friend auto operator*(dual const& lhs, dual const& rhs) -> dual
+    friend constexpr auto operator*(basic_dual const& lhs, basic_dual const& rhs) -> basic_dual
     {
         auto const [a, b] = *lhs;
         auto const [c, d] = *rhs;
         return {.a = a * c, .b = a * d + b * c};
     }
-    friend auto operator*(std::floating_point auto x, dual const& a) { return dual {x} * a; }
-    friend auto operator*(dual const& a, std::floating_point auto x) { return a * dual {x}; }
+    friend constexpr auto operator*(Number auto x, basic_dual const& a) { return basic_dual {T(x)} * a; }
+    friend constexpr auto operator*(basic_dual const& a, Number auto x) { return a * basic_dual {T(x)}; }
 
-    friend auto operator/(dual const& lhs, dual const& rhs) -> dual
+    friend constexpr auto operator/(basic_dual const& lhs, basic_dual const& rhs) -> basic_dual
     {
         auto const [a, b] = *lhs;
         auto const [c, d] = *rhs;
         return {.a = a / c, .b = (b * c - a * d) / (c * c)};
     }
-    friend auto operator/(std::floating_point auto x, dual const& a) { return dual {x} / a; }
-    friend auto operator/(dual const& a, std::floating_point auto x) { return a / dual {x}; }
-
-    friend auto operator-(dual const& a) { return -1.0 * a; }
+    friend constexpr auto operator/(Number auto x, basic_dual const& a) { return basic_dual {T(x)} / a; }
+    friend constexpr auto operator/(basic_dual const& a, Number auto x) { return a / basic_dual {T(x)}; }
 
-    auto sin() const -> dual
-    {
-        auto const [a, b] = this->operator*();
-        return {.a = std::sin(a), .b = b * std::cos(a)};
-    }
+    friend constexpr auto operator-(basic_dual const& a) { return T {-1} * a; }
 
-    auto cos() const -> dual
-    {
-        auto const [a, b] = this->operator*();
-        return {.a = std::cos(a), .b = -b * std::sin(a)};
-    }
+    constexpr auto sin() const -> basic_dual { return chain(kernel::sin(a)); }
+    constexpr auto cos() const -> basic_dual { return chain(kernel::cos(a)); }
+    constexpr auto exp() const -> basic_dual { return chain(kernel::exp(a)); }
+    constexpr auto log() const -> basic_dual { return chain(kernel::log(a)); }
 
-    auto exp() const -> dual
-    {
-        auto const [a, b] = this->operator*();
-        return {.a = std::exp(a), .b = b * std::exp(a)};
-    }
+    // chain rule on a fused value/derivative pair evaluated at a
+    constexpr auto chain(kernel::Eval<T> const& f) const -> basic_dual { return {.a = f.value, .b = b * f.derivative}; }
 
-    auto log() const -> dual
-    {
-        auto const [a, b] = this->operator*();
-        return {.a = std::log(a), .b = b / a};
-    }
+    // free functions, so generic code (e.g. a reverse::Tape over duals) finds
+    // them by argument-dependent lookup
+    friend constexpr auto sin(basic_dual const& x) -> basic_dual { return x.sin(); }
+    friend constexpr auto cos(basic_dual const& x) -> basic_dual { return x.cos(); }
+    friend constexpr auto exp(basic_dual const& x) -> basic_dual { return x.exp(); }
+    friend constexpr auto log(basic_dual const& x) -> basic_dual { return x.log(); }
 };
+
+// the scalar dual number over double, with a single tangent
+using dual = basic_dual<>;
 }  // namespace forward
 
 #endif
@@ -0,0 +1,190 @@
+#ifndef REVERSE_AD_DEMO_ELIMINATE_HPP
+#define REVERSE_AD_DEMO_ELIMINATE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+#include "expr.hpp"
+
+namespace reverse
+{
+
+// how far vertex elimination goes
+// - greedy: only eliminate vertices whose fill-in is smaller than the edges
+//   they remove (e.g. chains of unary operations), so every step leaves
+//   strictly fewer edges to sweep
+// - full: eliminate every intermediate vertex, so the kept nodes end up with
+//   edges straight to the leaves, i.e. the tape holds the jacobian itself
+enum class Elimination : std::uint8_t
+{
+    greedy,
+    full,
+};
+
+struct EliminationStats
+{
+    std::size_t eliminated;  // number of vertices removed from the graph
+    std::size_t edges_before;  // multiply-adds of a full sweep before and after
+    std::size_t edges_after;
+};
+
+// cross-country vertex elimination on the recorded computational graph.
+// eliminating an intermediate vertex v folds its partials into the edges of
+// its neighbors: every predecessor p and successor s get an edge p -> s with
+// partial d(s)/d(v) * d(v)/d(p) (added to an existing one). vertices are picked
+// in Markowitz order, i.e. the one with the smallest product of in- and
+// out-degree first, which keeps the fill-in low. only nodes from first on are
+// touched; leaves, nodes below first and the nodes of the variables in keep
+// (typically the outputs) are never eliminated, and only their adjoints
+// remain meaningful. eliminated nodes stay on the tape as nodes without edges,
+// so node indices and existing variables remain valid: the tape gets smaller in
+// edges, not in nodes, and a dense sweep still visits every node. on a
+// recording tape the rewritten nodes are tagged as statements and can no
+// longer be replayed
+template<typename Tp, std::ranges::input_range K>
+auto eliminate(Tp& tape, K const& keep, Elimination mode = Elimination::greedy, std::size_t first = 0)
+    -> EliminationStats
+{
+    using T = typename Tp::Scalar;
+    using S = typename Tp::Storage;
+
+    struct Edge
+    {
+        std::size_t node;
+        T partial;
+    };
+
+    auto& nodes = tape.nodes;
+    auto const n = tape.length();
+    if (first >= n) {
+        return {0, 0, 0};
+    }
+    EliminationStats stats {0, nodes.edges() - nodes.begin(first), 0};
+
+    // graph of the nodes from first on, indexed relative to first
+    auto const m = n - first;
+    std::vector<std::vector<Edge>> preds(m);
+    std::vector<std::vector<Edge>> succs(m);
+    std::vector<bool> candidate(m, false);
+    std::vector<bool> changed(m, false);
+
+    // accumulates partial p into the edge to node k of list, or appends it
+    auto merge = [](std::vector<Edge>& list, std::size_t k, T p) {
+        auto it = std::ranges::find(list, k, &Edge::node);
+        if (it == list.end()) {
+            list.push_back({k, p});
+        } else {
+            it->partial = it->partial + p;
+        }
+    };
+    auto erase = [](std::vector<Edge>& list, std::size_t k) {
+        std::erase_if(list, [k](Edge const& e) { return e.node == k; });
+    };
+
+    for (auto i = first; i < n; ++i) {
+        for (auto j = nodes.begin(i), end = nodes.end(i); j < end; ++j) {
+            auto const input = nodes.inputs[j];
+            auto const partial = static_cast<T>(nodes.partials[j]);
+            merge(preds[i - first], input, partial);
+            if (input >= first) {
+                merge(succs[input - first], i, partial);
+            }
+        }
+        candidate[i - first] = nodes.arity(i) > 0;
+    }
+    for (auto const& v : keep) {
+        if (v.index >= first) {
+            candidate[v.index - first] = false;
+        }
+    }
+
+    auto fill = [&](std::size_t v) {
+        return std::size(preds[v]) * std::size(succs[v]);
+    };
+    auto eligible = [&](std::size_t v) {
+        return mode == Elimination::full || fill(v) < std::size(preds[v]) + std::size(succs[v]);
+    };
+
+    using Entry = std::pair<std::size_t, std::size_t>;  // (markowitz cost, vertex)
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> queue;
+    for (auto v = 0UL; v < m; ++v) {
+        if (candidate[v]) {
+            queue.emplace(fill(v), v);
+        }
+    }
+
+    while (!queue.empty()) {
+        auto const [cost, v] = queue.top();
+        queue.pop();
+        if (!candidate[v] || cost != fill(v)) {
+            continue;  // already eliminated or a stale entry (re-queued with its current cost)
+        }
+        if (!eligible(v)) {
+            continue;  // re-queued if the degrees of v change
+        }
+
+        auto const vi = v + first;
+        for (auto const& [p, a] : preds[v]) {
+            if (p >= first) {
+                erase(succs[p - first], vi);
+            }
+        }
+        for (auto const& [s, b] : succs[v]) {
+            erase(preds[s - first], vi);
+            changed[s - first] = true;
+            for (auto const& [p, a] : preds[v]) {
+                merge(preds[s - first], p, a * b);
+                if (p >= first) {
+                    merge(succs[p - first], s, a * b);
+                }
+            }
+        }
+
+        // the neighbors' degrees changed, queue them again with their new cost
+        for (auto const& [p, a] : preds[v]) {
+            if (p >= first && candidate[p - first]) {
+                queue.emplace(fill(p - first), p - first);
+            }
+        }
+        for (auto const& [s, b] : succs[v]) {
+            if (candidate[s - first]) {
+                queue.emplace(fill(s - first), s - first);
+            }
+        }
+
+        preds[v].clear();
+        succs[v].clear();
+        candidate[v] = false;
+        changed[v] = true;
+        ++stats.eliminated;
+    }
+
+    // rewrite the nodes from first on, keeping their indices
+    nodes.resize(first);
+    for (auto i = first; i < n; ++i) {
+        nodes.add_node();
+        for (auto const& [input, partial] : preds[i - first]) {
+            nodes.add_edge(input, static_cast<S>(partial));
+        }
+        if constexpr (requires { tape.trace; }) {
+            if (tape.recording && changed[i - first]) {
+                tape.trace.ops[i] = Op::statement;
+            }
+        }
+    }
+    if constexpr (requires { tape.subexpressions; }) {
+        tape.subexpressions.rewind(first);  // the rewritten nodes no longer match their keys
+    }
+    stats.edges_after = nodes.edges() - nodes.begin(first);
+    return stats;
+}
+
+}  // namespace reverse
+
+#endif
@@ -1,175 +1,1205 @@
 #ifndef REVERSE_AD_DEMO_EXPR_HPP
 #define REVERSE_AD_DEMO_EXPR_HPP
 
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <ranges>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+// set by the reverse-ad-demo_USE_UNORDERED_DENSE CMake option
+#ifdef REVERSE_AD_DEMO_USE_UNORDERED_DENSE
+#    include <ankerl/unordered_dense.h>
+#else
+#    include <unordered_map>
+#endif
+
+#include "chunked.hpp"
+#include "kernels.hpp"
+#include "simd.hpp"
+
 namespace reverse
 {
 
+// scalar types a tape can be recorded over: builtin numbers as well as
+// number-like types such as forward::dual or simd::pack, as long as they have
+// field arithmetic and can be built from a plain number. elementary functions
+// are found by argument-dependent lookup. variables themselves do not qualify,
+// which keeps the mixed Var/constant overloads below unambiguous
 template<typename T>
-concept Arithmetic = requires { std::is_arithmetic_v<T>; };
+concept Arithmetic = std::constructible_from<T, double> && requires(T a, T b) {
+    { a + b };
+    { a - b };
+    { a * b };
+    { a / b };
+};
 
-template<Arithmetic T>
+// read-only view over the edges of a single node
+template<typename U, typename Alloc>
+struct EdgeRange
+{
+    ChunkedArray<U, Alloc> const* data;
+    std::size_t first;
+    std::size_t last;
+
+    auto operator[](std::size_t j) const -> U const& { return (*data)[first + j]; }
+    auto size() const -> std::size_t { return last - first; }
+};
+
+template<Arithmetic T, typename Alloc = std::allocator<T>>
 struct Node
 {
-    std::array<T, 2> partials {T {0}, T {0}};  // partial derivative values
-    std::array<std::size_t, 2> inputs {0, 0};  // indices of input nodes
+    EdgeRange<T, Alloc> partials;  // partial derivative values
+    EdgeRange<std::size_t, Alloc> inputs;  // indices of input nodes
 };
 
-// forward declaration
+// structure-of-arrays node storage in compressed sparse row form: every node has
+// a variable number of edges (0 for leaves, 1 for unary, 2 for binary and N for
+// n-ary operations), stored contiguously in the partials and inputs streams from
+// offsets[i] up to the offset of the next node. the reverse sweep reads each
+// stream linearly and never touches dead slots. each stream is a chunked array,
+// so appending never copies the tape and node addresses remain stable
+template<Arithmetic T, typename Alloc = std::allocator<T>>
+struct Nodes
+{
+    using allocator_type = Alloc;
+
+    Nodes() = default;
+
+    explicit Nodes(Alloc const& alloc)
+        : offsets(alloc)
+        , partials(alloc)
+        , inputs(alloc)
+    {
+    }
+
+    ChunkedArray<std::size_t, Alloc> offsets;  // index of the first edge of each node
+    ChunkedArray<T, Alloc> partials;  // partial derivative value of each edge
+    ChunkedArray<std::size_t, Alloc> inputs;  // input node index of each edge
+
+    auto size() const -> std::size_t { return std::size(offsets); }
+    auto edges() const -> std::size_t { return std::size(partials); }
+
+    // edge range of node i is [begin(i), end(i))
+    auto begin(std::size_t i) const -> std::size_t { return offsets[i]; }
+    auto end(std::size_t i) const -> std::size_t { return i + 1 < size() ? offsets[i + 1] : edges(); }
+    auto arity(std::size_t i) const -> std::size_t { return end(i) - begin(i); }
+
+    // appends a node without edges and returns its index
+    auto add_node() -> std::size_t
+    {
+        auto idx = size();
+        offsets.push_back(edges());
+        return idx;
+    }
+
+    // appends an edge to the last node
+    auto add_edge(std::size_t input, T partial) -> void
+    {
+        partials.push_back(partial);
+        inputs.push_back(input);
+    }
+
+    // truncates to the first n nodes, or pads with leaves
+    auto resize(std::size_t n)
+    {
+        if (n < size()) {
+            auto const e = begin(n);
+            partials.resize(e);
+            inputs.resize(e);
+            offsets.resize(n);
+        }
+        while (size() < n) {
+            add_node();
+        }
+    }
+
+    auto operator[](std::size_t i) const -> Node<T, Alloc>
+    {
+        auto const b = begin(i);
+        auto const e = end(i);
+        return {{&partials, b, e}, {&inputs, b, e}};
+    }
+
+    // drops all nodes and releases the underlying memory blocks
+    auto clear()
+    {
+        offsets.clear();
+        partials.clear();
+        inputs.clear();
+    }
+};
+
+// elementary operation that produced a node, kept by recording tapes for replay
+enum class Op : std::uint8_t
+{
+    leaf,
+    add,
+    sub,
+    mul,
+    div,
+    add_const,  // x + c, c + x
+    sub_const,  // x - c
+    const_sub,  // c - x
+    mul_const,  // x * c, c * x
+    div_const,  // x / c
+    const_div,  // c / x
+    sin,
+    cos,
+    exp,
+    log,
+    sum,
+    product,
+    statement,  // preaccumulated expression (see statement.hpp), partials are kept but it cannot be re-evaluated
+};
+
+// comparison operators on variables, recorded as branch guards
+enum class Cmp : std::uint8_t
+{
+    lt,
+    le,
+    gt,
+    ge,
+};
+
+// a comparison evaluated while recording, together with its outcome. if the
+// outcome differs when re-evaluated at new inputs, the recorded control flow
+// no longer matches what the user code would do and the replay is invalid
 template<Arithmetic T>
-struct Var;
+struct Guard
+{
+    static constexpr auto constant_operand {static_cast<std::size_t>(-1)};
+
+    Cmp cmp;
+    bool outcome;
+    std::size_t lhs;  // node index or constant_operand
+    std::size_t rhs;  // node index or constant_operand
+    T constant;  // value of the constant operand, if any
+
+    static auto compare(Cmp cmp, T a, T b) -> bool
+    {
+        switch (cmp) {
+            case Cmp::lt:
+                return a < b;
+            case Cmp::le:
+                return a <= b;
+            case Cmp::gt:
+                return a > b;
+            case Cmp::ge:
+                return a >= b;
+        }
+        return false;
+    }
+};
+
+// per-node primal information kept by a recording tape: the operation, its
+// result and its scalar operand. this is enough to re-evaluate the recorded
+// function at new inputs without calling user code again
+template<Arithmetic T, typename Alloc = std::allocator<T>>
+struct Trace
+{
+    Trace() = default;
+
+    explicit Trace(Alloc const& alloc)
+        : ops(alloc)
+        , values(alloc)
+        , constants(alloc)
+        , guards(alloc)
+    {
+    }
+
+    ChunkedArray<Op, Alloc> ops;
+    ChunkedArray<T, Alloc> values;
+    ChunkedArray<T, Alloc> constants;  // scalar operand of the *_const operations
+    ChunkedArray<Guard<T>, Alloc> guards;
+
+    auto size() const -> std::size_t { return std::size(ops); }
+
+    // keeps the first n nodes and the first g guards
+    auto resize(std::size_t n, std::size_t g)
+    {
+        ops.resize(std::min(n, size()));
+        values.resize(std::min(n, std::size(values)));
+        constants.resize(std::min(n, std::size(constants)));
+        guards.resize(std::min(g, std::size(guards)));
+    }
 
+    auto clear()
+    {
+        ops.clear();
+        values.clear();
+        constants.clear();
+        guards.clear();
+    }
+};
+
+// hash-consing table of the nodes recorded so far, for common subexpression
+// elimination at record time. a node is identified by its operation, its
+// inputs and its scalar operand; the table maps a hash of these to the first
+// node with them, and a hit is confirmed against the edges on the tape, so
+// hash collisions only cost a missed share. add and mul are keyed on their
+// sorted inputs. leaves are distinct variables and statements carry partials
+// that their inputs do not determine, so neither is ever shared, nor are
+// operations with a scalar operand unless T is a floating point type, whose
+// constants are compared bitwise
 template<Arithmetic T>
+struct Subexpressions
+{
+    struct Entry
+    {
+        std::size_t node;
+        Op op;
+        T constant;  // scalar operand, compared in full precision
+    };
+
+#ifdef REVERSE_AD_DEMO_USE_UNORDERED_DENSE
+    ankerl::unordered_dense::map<std::uint64_t, Entry> table;
+#else
+    std::unordered_map<std::uint64_t, Entry> table;
+#endif
+    std::vector<std::uint64_t> history;  // hash of each inserted node, in node order
+
+    static auto shareable(Op op) -> bool
+    {
+        switch (op) {
+            case Op::leaf:
+            case Op::statement:
+                return false;
+            case Op::add_const:
+            case Op::sub_const:
+            case Op::const_sub:
+            case Op::mul_const:
+            case Op::div_const:
+            case Op::const_div:
+                return std::is_floating_point_v<T>;
+            default:
+                return true;
+        }
+    }
+
+    static auto mix(std::uint64_t h, std::uint64_t x) -> std::uint64_t
+    {
+        h = (h ^ x) * 0x9e3779b97f4a7c15ULL;
+        return h ^ (h >> 32U);
+    }
+
+    // hash of the scalar operand. types wider than double also mix in the
+    // rounding residual; hits still compare the full constants with same()
+    static auto bits(T constant) -> std::uint64_t
+    {
+        if constexpr (std::is_floating_point_v<T>) {
+            auto const hi = static_cast<double>(constant);
+            auto h = std::bit_cast<std::uint64_t>(hi);
+            if constexpr (sizeof(T) > sizeof(double)) {
+                h = mix(h, std::bit_cast<std::uint64_t>(static_cast<double>(constant - static_cast<T>(hi))));
+            }
+            return h;
+        } else {
+            return 0;
+        }
+    }
+
+    static auto same(T const& a, T const& b) -> bool
+    {
+        if constexpr (std::is_floating_point_v<T>) {
+            // value identity without float ==: ordered equality plus the sign of zero. nan is unordered,
+            // so it would pass the ordered test against anything and is rejected first. unlike memcmp
+            // this ignores the padding bytes of long double
+            if (std::isnan(a) || std::isnan(b)) {
+                return false;
+            }
+            return !(a < b) && !(b < a) && std::signbit(a) == std::signbit(b);
+        } else {
+            return true;  // not shareable(), the constant is unused
+        }
+    }
+
+    // returns the index of an earlier node equal to the last node idx of the
+    // tape, or idx itself after registering it
+    template<typename Nd>
+    auto share(Nd const& nodes, Op op, T constant, std::size_t idx) -> std::size_t
+    {
+        auto const n = nodes.arity(idx);
+        auto const commutative = (op == Op::add || op == Op::mul) && n == 2;
+        auto input = [&](std::size_t i, std::size_t j) {
+            auto const k = nodes.begin(i);
+            if (commutative) {
+                auto const x = nodes.inputs[k];
+                auto const y = nodes.inputs[k + 1];
+                return j == 0 ? std::min(x, y) : std::max(x, y);
+            }
+            return nodes.inputs[k + j];
+        };
+
+        auto h = mix(mix(static_cast<std::uint64_t>(op), bits(constant)), n);
+        for (auto j = 0UL; j < n; ++j) {
+            h = mix(h, input(idx, j));
+        }
+
+        auto const [it, inserted] = table.try_emplace(h, Entry {idx, op, constant});
+        if (inserted) {
+            history.push_back(h);
+            return idx;
+        }
+        auto const& e = it->second;
+        if (e.op != op || !same(e.constant, constant) || nodes.arity(e.node) != n) {
+            return idx;
+        }
+        for (auto j = 0UL; j < n; ++j) {
+            if (input(e.node, j) != input(idx, j)) {
+                return idx;
+            }
+        }
+        return e.node;
+    }
+
+    // forgets every node from n on
+    auto rewind(std::size_t n) -> void
+    {
+        while (!history.empty()) {
+            auto const it = table.find(history.back());
+            assert(it != table.end());  // every hash in history has its entry
+            if (it == table.end() || it->second.node < n) {
+                break;
+            }
+            table.erase(it);
+            history.pop_back();
+        }
+    }
+
+    auto clear()
+    {
+        table.clear();
+        history.clear();
+    }
+};
+
+// reverse sweep strategies
+// - dense: visit every node from the output down to the start of the tape
+// - sparse: same order, but skip nodes that never received an adjoint
+// - cone: first collect the dependency cone of the output and only visit it,
+//   so the cost is proportional to the cone rather than to the tape
+// - refined: sparse order, but every partial is recomputed in full precision
+//   from the recorded trace instead of read back from storage. only for
+//   recording tapes, typically ones that store partials in a narrower type;
+//   on other tapes it falls back to a sparse sweep over the stored partials
+enum class Sweep : std::uint8_t
+{
+    dense,
+    sparse,
+    cone,
+    refined,
+};
+
+// forward declarations
+template<Arithmetic T, typename Alloc = std::allocator<T>, Arithmetic S = T>
+struct Tape;
+
+template<Arithmetic T, typename Tp = Tape<T>>
+struct Var;
+
+// records nodes over scalar type T. partials are stored as S, which may be
+// narrower than T (e.g. float or bfloat16 for a double tape); they are widened
+// back to T as they are read, so adjoints still accumulate in T. only the
+// partial stream narrows: input indices and offsets keep their size, and
+// variable and trace values stay T. on a double tape an edge shrinks from 16
+// to 12 bytes with float partials and to 10 with bfloat16, well short of half.
+template<Arithmetic T, typename Alloc, Arithmetic S>
 struct Tape
 {
     using Scalar = T;
-    using Variable = Var<T>;
-    std::vector<Node<T>> nodes;
+    using Storage = S;
+    using Variable = Var<T, Tape>;
+    using allocator_type = Alloc;
+
+    Tape() = default;
+
+    explicit Tape(Alloc const& alloc)
+        : nodes(alloc)
+        , trace(alloc)
+    {
+    }
+
+    Nodes<S, Alloc> nodes;
+    Trace<T, Alloc> trace;  // only filled while recording
+    Subexpressions<T> subexpressions;  // only filled while sharing
+    bool recording {false};  // keep opcodes and primal values so the tape can be replayed
+    bool sharing {false};  // return the existing node for a repeated subexpression instead of recording it again
 
-    auto push() -> std::size_t
+    // leaf node (independent variable or constant)
+    auto push() -> std::size_t { return nodes.add_node(); }
+
+    // unary node
+    auto push(std::integral auto i, auto p) -> std::size_t
     {
-        auto idx = std::size(nodes);
-        nodes.push_back({{T {0}, T {0}}, {idx, idx}});
+        auto idx = nodes.add_node();
+        nodes.add_edge(i, static_cast<S>(T(p)));
         return idx;
     }
 
-    auto push(auto i, auto p) -> std::size_t
+    // binary node
+    auto push(std::integral auto i0, auto p0, std::integral auto i1, auto p1) -> std::size_t
     {
-        auto idx = std::size(nodes);
-        nodes.push_back({{T {p}, T {0}}, {i, idx}});
+        auto idx = nodes.add_node();
+        nodes.add_edge(i0, static_cast<S>(T(p0)));
+        nodes.add_edge(i1, static_cast<S>(T(p1)));
         return idx;
     }
 
-    auto push(auto i0, auto p0, auto i1, auto p1) -> std::size_t
+    // n-ary node with one edge per (input, partial) pair
+    template<std::ranges::input_range I, std::ranges::input_range P>
+    auto push(I&& inputs, P&& partials) -> std::size_t
     {
-        auto idx = std::size(nodes);
-        nodes.push_back({{T {p0}, T {p1}}, {i0, i1}});
+        auto idx = nodes.add_node();
+        auto p = std::ranges::begin(partials);
+        for (auto i : inputs) {
+            assert(p != std::ranges::end(partials));
+            nodes.add_edge(i, static_cast<S>(T(*p++)));
+        }
         return idx;
     }
 
     auto length() const -> std::size_t { return std::size(nodes); }
 
-    auto variable(T value) { return Var<T> {*this, value, push()}; }
+    // position on the tape, see mark() and rewind()
+    struct Mark
+    {
+        std::size_t nodes;
+        std::size_t guards;
+    };
+
+    auto mark() const -> Mark { return {length(), std::size(trace.guards)}; }
+
+    // pops every node recorded after m. the memory blocks are kept, so recording
+    // the same amount of work again does not allocate
+    auto rewind(Mark m) -> void
+    {
+        assert(m.nodes <= length());
+        nodes.resize(m.nodes);
+        trace.resize(m.nodes, m.guards);
+        subexpressions.rewind(m.nodes);
+    }
+
+    // scoped sub-recording: everything recorded during the lifetime of the scope
+    // is popped when it ends. variables created inside must not outlive it
+    struct Scope
+    {
+        explicit Scope(Tape& t)
+            : tape(t)
+            , mark(t.mark())
+        {
+        }
+
+        Scope(Scope const&) = delete;
+        Scope(Scope&&) = delete;
+        auto operator=(Scope const&) -> Scope& = delete;
+        auto operator=(Scope&&) -> Scope& = delete;
 
-    auto clear() { nodes.clear(); }
+        ~Scope() { tape.rewind(mark); }
+
+        Tape& tape;
+        Mark mark;
+    };
+
+    auto variable(T value) { return record(Op::leaf, value, push()); }
+
+    // propagates seeded adjoints from node last down to node first. the adjoint
+    // type only needs += and scaling by T, so the same sweep serves scalar and
+    // lane-packed (vector mode) adjoints. nodes below first are not visited:
+    // they receive adjoints but are treated as independent, which lets a sweep
+    // stop at a mark instead of walking a shared prefix. for Sweep::cone the
+    // cone must have been marked (with the same lower bound) before seeding
+    template<typename A>
+    auto backward(A& adjoints, std::size_t last, Sweep mode, std::size_t first = 0) const -> void
+    {
+        auto const& partials = nodes.partials;
+        auto const& inputs = nodes.inputs;
+
+        if (mode == Sweep::refined && !(recording && std::size(trace) == length())) {
+            mode = Sweep::sparse;  // no trace to recompute from
+        }
+        if (mode == Sweep::refined) {
+            // the scalar workspace keeps the scratch buffer, other adjoint types
+            // (e.g. vector mode) reuse one per thread
+            auto& exact = [&]() -> std::vector<T>& {
+                if constexpr (requires { { adjoints.exact } -> std::same_as<std::vector<T>&>; }) {
+                    return adjoints.exact;
+                } else {
+                    thread_local std::vector<T> scratch;
+                    return scratch;
+                }
+            }();
+            for (auto i = last + 1; i-- > first;) {
+                if (adjoints.touched(i)) {
+                    auto const d = adjoints[i];
+                    exact_partials(i, exact);
+                    for (auto j = nodes.begin(i), end = nodes.end(i); j < end; ++j) {
+                        adjoints.add(inputs[j], exact[j - nodes.begin(i)] * d);
+                    }
+                }
+            }
+            return;
+        }
+
+        if constexpr (requires { adjoints.cone; }) {
+            if (mode == Sweep::cone) {
+                // every cone node is stamped, so no stamp checks are needed here
+                for (auto i : adjoints.cone) {
+                    if (i < first) {
+                        break;
+                    }
+                    auto const d = adjoints.values[i];
+                    for (auto j = nodes.begin(i), end = nodes.end(i); j < end; ++j) {
+                        adjoints.values[inputs[j]] += static_cast<T>(partials[j]) * d;
+                    }
+                }
+                return;
+            }
+        }
+        // workspaces without a cone list (StaticAdjoints) only stamp the roots,
+        // the sparse order below then visits exactly the cone
+
+        auto end = nodes.end(last);
+        for (auto i = last + 1; i-- > first;) {
+            auto const begin = nodes.offsets[i];
+            if (mode == Sweep::dense || adjoints.touched(i)) {
+                auto const d = adjoints[i];
+                for (auto j = begin; j < end; ++j) {
+                    adjoints.add(inputs[j], static_cast<T>(partials[j]) * d);
+                }
+            }
+            end = begin;
+        }
+    }
+
+    // wraps the node at idx into a variable, annotating it when recording. when
+    // sharing and an equal node exists, the new one is popped again and the
+    // variable refers to the existing node
+    auto record(Op op, T value, std::size_t idx, T constant = T {0}) -> Variable
+    {
+        if (sharing && Subexpressions<T>::shareable(op)) {
+            assert(idx + 1 == length());
+            auto const existing = subexpressions.share(nodes, op, constant, idx);
+            if (existing != idx) {
+                nodes.resize(idx);
+                return Variable {*this, value, existing};
+            }
+        }
+        if (recording) {
+            assert(std::size(trace) == idx);  // every node must come from the Var API
+            trace.ops.push_back(op);
+            trace.values.push_back(value);
+            trace.constants.push_back(constant);
+        }
+        return Variable {*this, value, idx};
+    }
+
+    // evaluates a comparison, remembering its outcome when recording
+    auto branch(Cmp cmp, std::size_t lhs, T a, std::size_t rhs, T b) -> bool
+    {
+        auto const outcome = Guard<T>::compare(cmp, a, b);
+        if (recording) {
+            auto const constant = lhs == Guard<T>::constant_operand ? a : b;
+            trace.guards.push_back({cmp, outcome, lhs, rhs, constant});
+        }
+        return outcome;
+    }
+
+    auto value(std::size_t i) const -> T { return trace.values[i]; }
+
+    // changes the value of a recorded leaf, to be followed by replay()
+    auto set_value(std::size_t i, T v) -> void
+    {
+        assert(trace.ops[i] == Op::leaf);
+        trace.values[i] = v;
+    }
+
+    // re-evaluates the recorded function forward from the current leaf values,
+    // refreshing node values and partials in place. returns false when a branch
+    // guard changes outcome, i.e. the user code would have taken a different path
+    // and the replayed tape does not describe the function at these inputs. it
+    // also returns false for tapes holding statement nodes, which keep no
+    // expression to re-evaluate
+    auto replay() -> bool
+    {
+        assert(recording && std::size(trace) == length());
+        auto& values = trace.values;
+        auto& partials = nodes.partials;
+        auto const& inputs = nodes.inputs;
+
+        auto valid = true;
+        for (auto i = 0UL; i < length(); ++i) {
+            auto const b = nodes.begin(i);
+            auto const e = nodes.end(i);
+            auto const c = trace.constants[i];
+            auto x = [&](std::size_t j) { return values[inputs[b + j]]; };
+            auto unary = [&](kernel::Eval<T> const& f) {
+                values[i] = f.value;
+                partials[b] = static_cast<S>(f.derivative);
+            };
+
+            switch (trace.ops[i]) {
+                case Op::leaf:
+                    break;
+                case Op::add:
+                    values[i] = x(0) + x(1);
+                    break;
+                case Op::sub:
+                    values[i] = x(0) - x(1);
+                    break;
+                case Op::mul:
+                    values[i] = x(0) * x(1);
+                    partials[b] = static_cast<S>(x(1));
+                    partials[b + 1] = static_cast<S>(x(0));
+                    break;
+                case Op::div:
+                    values[i] = x(0) / x(1);
+                    partials[b] = static_cast<S>(1 / x(1));
+                    partials[b + 1] = static_cast<S>(-x(0) / (x(1) * x(1)));
+                    break;
+                case Op::add_const:
+                    values[i] = x(0) + c;
+                    break;
+                case Op::sub_const:
+                    values[i] = x(0) - c;
+                    break;
+                case Op::const_sub:
+                    values[i] = c - x(0);
+                    break;
+                case Op::mul_const:
+                    values[i] = x(0) * c;
+                    break;
+                case Op::div_const:
+                    values[i] = x(0) / c;
+                    break;
+                case Op::const_div:
+                    values[i] = c / x(0);
+                    partials[b] = static_cast<S>(-c / (x(0) * x(0)));
+                    break;
+                case Op::sin:
+                    unary(kernel::sin(x(0)));
+                    break;
+                case Op::cos:
+                    unary(kernel::cos(x(0)));
+                    break;
+                case Op::exp:
+                    unary(kernel::exp(x(0)));
+                    break;
+                case Op::log:
+                    unary(kernel::log(x(0)));
+                    break;
+                case Op::sum: {
+                    auto v = T {0};
+                    for (auto j = b; j < e; ++j) {
+                        v += values[inputs[j]];
+                    }
+                    values[i] = v;
+                    break;
+                }
+                case Op::product: {
+                    auto prefix = T {1};
+                    for (auto j = b; j < e; ++j) {
+                        partials[j] = static_cast<S>(prefix);
+                        prefix *= values[inputs[j]];
+                    }
+                    auto suffix = T {1};
+                    for (auto j = e; j-- > b;) {
+                        partials[j] = static_cast<S>(static_cast<T>(partials[j]) * suffix);
+                        suffix *= values[inputs[j]];
+                    }
+                    values[i] = prefix;
+                    break;
+                }
+                case Op::statement:
+                    valid = false;
+                    break;
+            }
+        }
+
+        for (auto k = 0UL; k < std::size(trace.guards); ++k) {
+            auto const& g = trace.guards[k];
+            auto const a = g.lhs == Guard<T>::constant_operand ? g.constant : values[g.lhs];
+            auto const b = g.rhs == Guard<T>::constant_operand ? g.constant : values[g.rhs];
+            valid &= Guard<T>::compare(g.cmp, a, b) == g.outcome;
+        }
+        return valid;
+    }
+
+    // partials of node i in full precision, recomputed from the recorded trace
+    // (one per edge, in edge order). used by Sweep::refined
+    auto exact_partials(std::size_t i, std::vector<T>& out) const -> void
+    {
+        auto const& values = trace.values;
+        auto const b = nodes.begin(i);
+        auto const n = nodes.arity(i);
+        auto const c = trace.constants[i];
+        auto x = [&](std::size_t j) { return values[nodes.inputs[b + j]]; };
+
+        out.assign(n, T {0});
+        switch (trace.ops[i]) {
+            case Op::leaf:
+                break;
+            case Op::add:
+            case Op::sum:
+                std::fill(out.begin(), out.end(), T {1});
+                break;
+            case Op::sub:
+                out[0] = T {1};
+                out[1] = T {-1};
+                break;
+            case Op::mul:
+                out[0] = x(1);
+                out[1] = x(0);
+                break;
+            case Op::div:
+                out[0] = 1 / x(1);
+                out[1] = -x(0) / (x(1) * x(1));
+                break;
+            case Op::add_const:
+            case Op::sub_const:
+                out[0] = T {1};
+                break;
+            case Op::const_sub:
+                out[0] = T {-1};
+                break;
+            case Op::mul_const:
+                out[0] = c;
+                break;
+            case Op::div_const:
+                out[0] = 1 / c;
+                break;
+            case Op::const_div:
+                out[0] = -c / (x(0) * x(0));
+                break;
+            case Op::sin:
+                out[0] = kernel::sin(x(0)).derivative;
+                break;
+            case Op::cos:
+                out[0] = kernel::cos(x(0)).derivative;
+                break;
+            case Op::exp:
+                out[0] = values[i];
+                break;
+            case Op::log:
+                out[0] = 1 / x(0);
+                break;
+            case Op::statement:  // nothing to recompute from, use the stored partials
+                for (auto j = 0UL; j < n; ++j) {
+                    out[j] = static_cast<T>(nodes.partials[b + j]);
+                }
+                break;
+            case Op::product: {
+                auto prefix = T {1};
+                for (auto j = 0UL; j < n; ++j) {
+                    out[j] = prefix;
+                    prefix = prefix * x(j);
+                }
+                auto suffix = T {1};
+                for (auto j = n; j-- > 0;) {
+                    out[j] = out[j] * suffix;
+                    suffix = suffix * x(j);
+                }
+                break;
+            }
+        }
+    }
+
+    auto clear()
+    {
+        nodes.clear();
+        trace.clear();
+        subexpressions.clear();
+    }
 };
 
+namespace pmr
+{
+// tape whose node blocks come from a std::pmr::memory_resource (e.g. a monotonic arena)
+template<Arithmetic T>
+using Tape = reverse::Tape<T, std::pmr::polymorphic_allocator<T>>;
+}  // namespace pmr
+
+// tape over T that stores its partials as S (e.g. MixedTape<double, float>)
+template<Arithmetic T, Arithmetic S>
+using MixedTape = Tape<T, std::allocator<T>, S>;
+
 template<Arithmetic T>
 struct grad
 {
-    auto wrt(Var<T> const& v) { return values[v.index]; }
+    template<typename Tp>
+    auto wrt(Var<T, Tp> const& v)
+    {
+        return values[v.index];
+    }
     std::vector<T> values;
 };
 
+// reusable adjoint buffer for reverse sweeps. an entry only holds a valid value
+// when its stamp equals the current generation, so starting a new sweep bumps
+// the generation instead of re-zeroing O(tape) memory
 template<Arithmetic T>
+struct Adjoints
+{
+    std::vector<T> values;
+    std::vector<std::uint32_t> stamps;
+    std::uint32_t generation {0};
+    std::vector<std::size_t> cone;  // scratch space for Sweep::cone
+    std::vector<T> exact;  // scratch space for Sweep::refined
+
+    // invalidates all entries and makes room for n nodes (only ever grows)
+    auto reset(std::size_t n) -> void
+    {
+        if (std::size(values) < n) {
+            values.resize(n, T {0});
+            stamps.resize(n, 0);
+        }
+        if (++generation == 0) {
+            // the stamp counter wrapped around, old stamps could look current
+            std::fill(stamps.begin(), stamps.end(), 0);
+            generation = 1;
+        }
+    }
+
+    auto operator[](std::size_t i) const -> T { return stamps[i] == generation ? values[i] : T {0}; }
+
+    auto touched(std::size_t i) const -> bool { return stamps[i] == generation; }
+
+    auto add(std::size_t i, T v) -> void
+    {
+        if (stamps[i] != generation) {
+            stamps[i] = generation;
+            values[i] = v;
+        } else {
+            values[i] += v;
+        }
+    }
+
+    template<typename Tp>
+    auto wrt(Var<T, Tp> const& v) const -> T
+    {
+        return (*this)[v.index];
+    }
+
+    // collects the dependency cone of the root nodes (every node they can reach
+    // through their inputs) in decreasing index order, i.e. a valid reverse
+    // sweep order. cone nodes get a current stamp and a zero value, others stay
+    // untouched
+    template<typename N>
+    auto mark_cone(N const& nodes, std::ranges::input_range auto&& roots, std::size_t first = 0) -> void
+    {
+        cone.clear();
+        for (auto root : roots) {
+            if (stamps[root] != generation) {
+                stamps[root] = generation;
+                values[root] = T {0};
+                cone.push_back(root);
+            }
+        }
+
+        for (auto k = 0UL; k < std::size(cone); ++k) {
+            auto const i = cone[k];
+            if (i < first) {
+                continue;  // below the lower bound of the sweep
+            }
+            for (auto j = nodes.begin(i), end = nodes.end(i); j < end; ++j) {
+                auto const input = nodes.inputs[j];
+                if (stamps[input] != generation) {
+                    stamps[input] = generation;
+                    values[input] = T {0};
+                    cone.push_back(input);
+                }
+            }
+        }
+        std::sort(cone.begin(), cone.end(), std::greater {});
+    }
+};
+
+template<Arithmetic T, typename Tp>
 struct Var
 {
-    explicit Var(Tape<T>& t, T v = T {0}, std::size_t i = 0)
+    explicit Var(Tp& t, T v = T {0}, std::size_t i = 0)
         : tape(t)
         , index(i)
         , value(v)
     {
     }
 
-    auto gradient() const -> grad<T>
+    auto gradient(Sweep mode = Sweep::dense) const -> grad<T>
     {
-        std::vector<T> grad(tape.length(), T {0.0});
-        grad[index] = 1.0;
-
-        for (auto i = tape.length() - 1; i < tape.length(); --i) {
-            auto const& n = tape.nodes[i];
-            auto d = grad[i];
+        // a fresh workspace is zero-initialized, so its values are the gradient
+        Adjoints<T> adjoints;
+        gradient_into(adjoints, T {1}, mode);
+        return {std::move(adjoints.values)};
+    }
 
-            for (auto j = 0UL; j < std::size(n.inputs); ++j) {
-                grad[n.inputs[j]] += n.partials[j] * d;
-            }
+    // reverse sweep into a caller-owned workspace; once the workspace has grown
+    // to the tape length, repeated calls do not allocate. the sweep starts at
+    // this variable's node, later nodes cannot contribute to its gradient, and
+    // stops at node first (e.g. a tape mark): earlier nodes are treated as
+    // independent variables. any workspace with the Adjoints interface works
+    template<typename A = Adjoints<T>>
+    auto gradient_into(A& adjoints, T seed = T {1}, Sweep mode = Sweep::dense, std::size_t first = 0) const -> void
+    {
+        adjoints.reset(tape.length());
+        if (mode == Sweep::cone) {
+            adjoints.mark_cone(tape.nodes, std::array {index}, first);
         }
-
-        return {grad};
+        adjoints.add(index, seed);
+        tape.backward(adjoints, index, mode, first);
     }
 
     friend auto operator+(Var const& a, Var const& b) -> Var
     {
         assert(&a.tape == &b.tape);
-        return Var {a.tape, a.value + b.value, a.tape.push(a.index, T {1.0}, b.index, T {1.0})};
+        return a.tape.record(Op::add, a.value + b.value, a.tape.push(a.index, T {1.0}, b.index, T {1.0}));
     }
 
     friend auto operator+(Arithmetic auto a, Var const& b) -> Var
     {
-        return Var {b.tape, a + b.value, b.tape.push(0UL, T {0.0}, b.index, T {1.0})};
+        return b.tape.record(Op::add_const, a + b.value, b.tape.push(b.index, T {1.0}), T(a));
     }
 
     friend auto operator+(Var const& a, Arithmetic auto b) -> Var
     {
-        return Var {a.tape, a.value + b, a.tape.push(a.index, T {1.0}, 0UL, T {0.0})};
+        return a.tape.record(Op::add_const, a.value + b, a.tape.push(a.index, T {1.0}), T(b));
     }
 
     friend auto operator-(Var const& a, Var const& b) -> Var
     {
         assert(&a.tape == &b.tape);
-        return Var {a.tape, a.value - b.value, a.tape.push(a.index, T {1.0}, b.index, T {-1.0})};
+        return a.tape.record(Op::sub, a.value - b.value, a.tape.push(a.index, T {1.0}, b.index, T {-1.0}));
     }
 
     friend auto operator-(Arithmetic auto a, Var const& b) -> Var
     {
-        return Var {b.tape, a - b.value, b.tape.push(0UL, T {0.0}, b.index, T {-1.0})};
+        return b.tape.record(Op::const_sub, a - b.value, b.tape.push(b.index, T {-1.0}), T(a));
     }
 
     friend auto operator-(Var const& a, Arithmetic auto b) -> Var
     {
-        return Var {a.tape, a.value - b, a.tape.push(a.index, T {1.0}, 0UL, T {0.0})};
+        return a.tape.record(Op::sub_const, a.value - b, a.tape.push(a.index, T {1.0}), T(b));
     }
 
     friend auto operator*(Var const& a, Var const& b) -> Var
     {
         assert(&a.tape == &b.tape);
-        return Var {a.tape, a.value * b.value, a.tape.push(a.index, b.value, b.index, a.value)};
+        return a.tape.record(Op::mul, a.value * b.value, a.tape.push(a.index, b.value, b.index, a.value));
     }
 
     friend auto operator*(Arithmetic auto a, Var const& b) -> Var
     {
-        return Var {b.tape, a * b.value, b.tape.push(0UL, T {0.0}, b.index, a)};
+        return b.tape.record(Op::mul_const, a * b.value, b.tape.push(b.index, a), T(a));
     }
 
     friend auto operator*(Var const& a, Arithmetic auto b) -> Var
     {
-        return Var {a.tape, a.value * b, a.tape.push(a.index, b, 0UL, T {0.0})};
+        return a.tape.record(Op::mul_const, a.value * b, a.tape.push(a.index, b), T(b));
     }
 
     friend auto operator/(Var const& a, Var const& b) -> Var
     {
         assert(&a.tape == &b.tape);
-        return Var {
-            a.tape, a.value / b.value, a.tape.push(a.index, 1 / b.value, b.index, -a.value / (b.value * b.value))};
+        return a.tape.record(Op::div,
+                             a.value / b.value,
+                             a.tape.push(a.index, 1 / b.value, b.index, -a.value / (b.value * b.value)));
     }
 
     friend auto operator/(Arithmetic auto a, Var const& b) -> Var
     {
-        return Var {b.tape, a / b.value, b.tape.push(0UL, T {0.0}, b.index, -1 / (b.value * b.value))};
+        return b.tape.record(Op::const_div, a / b.value, b.tape.push(b.index, -a / (b.value * b.value)), T(a));
     }
 
     friend auto operator/(Var const& a, Arithmetic auto b) -> Var
     {
-        return Var {a.tape, a.value / b, a.tape.push(a.index, 1.0 / b, 0UL, T {0.0})};
+        return a.tape.record(Op::div_const, a.value / b, a.tape.push(a.index, 1.0 / b), T(b));
+    }
+
+    // comparisons are recorded as branch guards so that replays can detect a
+    // change in control flow
+    friend auto operator<(Var const& a, Var const& b) -> bool
+    {
+        return a.tape.branch(Cmp::lt, a.index, a.value, b.index, b.value);
+    }
+
+    friend auto operator<(Var const& a, Arithmetic auto b) -> bool
+    {
+        return a.tape.branch(Cmp::lt, a.index, a.value, Guard<T>::constant_operand, T(b));
+    }
+
+    friend auto operator<(Arithmetic auto a, Var const& b) -> bool
+    {
+        return b.tape.branch(Cmp::lt, Guard<T>::constant_operand, T(a), b.index, b.value);
+    }
+
+    friend auto operator<=(Var const& a, Var const& b) -> bool
+    {
+        return a.tape.branch(Cmp::le, a.index, a.value, b.index, b.value);
+    }
+
+    friend auto operator<=(Var const& a, Arithmetic auto b) -> bool
+    {
+        return a.tape.branch(Cmp::le, a.index, a.value, Guard<T>::constant_operand, T(b));
+    }
+
+    friend auto operator<=(Arithmetic auto a, Var const& b) -> bool
+    {
+        return b.tape.branch(Cmp::le, Guard<T>::constant_operand, T(a), b.index, b.value);
+    }
+
+    friend auto operator>(Var const& a, Var const& b) -> bool
+    {
+        return a.tape.branch(Cmp::gt, a.index, a.value, b.index, b.value);
+    }
+
+    friend auto operator>(Var const& a, Arithmetic auto b) -> bool
+    {
+        return a.tape.branch(Cmp::gt, a.index, a.value, Guard<T>::constant_operand, T(b));
+    }
+
+    friend auto operator>(Arithmetic auto a, Var const& b) -> bool
+    {
+        return b.tape.branch(Cmp::gt, Guard<T>::constant_operand, T(a), b.index, b.value);
     }
 
-    auto sin() const -> Var { return Var {tape, std::sin(value), tape.push(index, std::cos(value))}; }
+    friend auto operator>=(Var const& a, Var const& b) -> bool
+    {
+        return a.tape.branch(Cmp::ge, a.index, a.value, b.index, b.value);
+    }
 
-    auto cos() const -> Var { return Var {tape, std::cos(value), tape.push(index, -std::sin(value))}; }
+    friend auto operator>=(Var const& a, Arithmetic auto b) -> bool
+    {
+        return a.tape.branch(Cmp::ge, a.index, a.value, Guard<T>::constant_operand, T(b));
+    }
 
-    auto exp() const -> Var { return Var {tape, std::exp(value), tape.push(index, std::exp(value))}; }
+    friend auto operator>=(Arithmetic auto a, Var const& b) -> bool
+    {
+        return b.tape.branch(Cmp::ge, Guard<T>::constant_operand, T(a), b.index, b.value);
+    }
 
-    auto log() const -> Var { return Var {tape, std::log(value), tape.push(index, 1 / value)}; }
+    auto sin() const -> Var { return apply(Op::sin, kernel::sin(value)); }
+    auto cos() const -> Var { return apply(Op::cos, kernel::cos(value)); }
+    auto exp() const -> Var { return apply(Op::exp, kernel::exp(value)); }
+    auto log() const -> Var { return apply(Op::log, kernel::log(value)); }
 
-    Tape<T>& tape;  // reference to the tape
+    // records a unary node from a fused value/derivative pair
+    auto apply(Op op, kernel::Eval<T> const& f) const -> Var
+    {
+        return tape.record(op, f.value, tape.push(index, f.derivative));
+    }
+
+    Tp& tape;  // reference to the tape
     std::size_t index {};  // index of the current node
     T value {};  // associated value
 };
+
+// n-ary sum: one node with a unit edge per term instead of a chain of binary nodes
+template<std::ranges::random_access_range R>
+auto sum(R const& terms)
+{
+    assert(!std::ranges::empty(terms));
+    using V = std::ranges::range_value_t<R>;
+    using T = decltype(V::value);
+
+    auto& tape = std::ranges::begin(terms)->tape;
+    auto value = T {0};
+    for (auto const& t : terms) {
+        assert(&t.tape == &tape);
+        value += t.value;
+    }
+    auto idx = tape.push(terms | std::views::transform(&V::index),
+                         terms | std::views::transform([](auto const&) { return T {1}; }));
+    return tape.record(Op::sum, value, idx);
+}
+
+// n-ary product: the partial w.r.t. each term is the product of all the other
+// terms, computed from prefix and suffix products (no division)
+template<std::ranges::random_access_range R>
+auto product(R const& terms)
+{
+    assert(!std::ranges::empty(terms));
+    using V = std::ranges::range_value_t<R>;
+    using T = decltype(V::value);
+    using S = typename std::remove_cvref_t<decltype(std::ranges::begin(terms)->tape)>::Storage;
+
+    auto& tape = std::ranges::begin(terms)->tape;
+    auto& nodes = tape.nodes;
+
+    auto idx = tape.push();
+    auto const first = nodes.edges();
+    auto prefix = T {1};
+    for (auto const& t : terms) {
+        assert(&t.tape == &tape);
+        nodes.add_edge(t.index, static_cast<S>(prefix));
+        prefix *= t.value;
+    }
+
+    auto suffix = T {1};
+    for (auto k = std::ranges::ssize(terms) - 1; k >= 0; --k) {
+        auto& p = nodes.partials[first + static_cast<std::size_t>(k)];
+        p = static_cast<S>(static_cast<T>(p) * suffix);
+        suffix *= std::ranges::begin(terms)[k].value;
+    }
+    return tape.record(Op::product, prefix, idx);
+}
+
+// vector-mode reverse sweep: every adjoint is a pack of K lanes, so K outputs
+// are seeded at once (one lane each) and the tape is read once per K rows of
+// the Jacobian. d outputs[r] / d inputs[c] is written to jacobian[c * ld + r],
+// i.e. a column-major block with leading dimension ld as used by Eigen
+template<typename T, std::size_t K, std::ranges::random_access_range O, std::ranges::random_access_range I>
+auto jacobian_into(O const& outputs,
+                   I const& inputs,
+                   Adjoints<simd::pack<T, K>>& adjoints,
+                   T* jacobian,
+                   std::size_t ld,
+                   Sweep mode = Sweep::sparse) -> void
+{
+    using V = std::ranges::range_value_t<O>;
+    auto const rows = std::size(outputs);
+    if (rows == 0) {
+        return;
+    }
+    auto const& tape = std::ranges::begin(outputs)->tape;
+
+    for (auto r = 0UL; r < rows; r += K) {
+        auto block = std::views::counted(std::ranges::begin(outputs) + static_cast<std::ptrdiff_t>(r),
+                                         static_cast<std::ptrdiff_t>(std::min(K, rows - r)));
+        adjoints.reset(tape.length());
+        if (mode == Sweep::cone) {
+            adjoints.mark_cone(tape.nodes, block | std::views::transform(&V::index));
+        }
+
+        auto last = 0UL;
+        auto lane = 0UL;
+        for (auto const& y : block) {
+            assert(&y.tape == &tape);
+            simd::pack<T, K> seed;
+            seed[lane++] = T {1};
+            adjoints.add(y.index, seed);
+            last = std::max(last, y.index);
+        }
+        tape.backward(adjoints, last, mode);
+
+        auto c = 0UL;
+        for (auto const& x : inputs) {
+            auto const d = adjoints[x.index];
+            for (auto k = 0UL; k < lane; ++k) {
+                jacobian[c * ld + r + k] = d[k];
+            }
+            ++c;
+        }
+    }
+}
+
 }  // namespace reverse
 
 #endif
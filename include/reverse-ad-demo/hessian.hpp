@@ -0,0 +1,57 @@
+#ifndef REVERSE_AD_DEMO_HESSIAN_HPP
+#define REVERSE_AD_DEMO_HESSIAN_HPP
+
+#include <cassert>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dual.hpp"
+#include "expr.hpp"
+
+namespace reverse
+{
+
+// forward-over-reverse hessian-vector products. f is recorded on a tape over
+// dual numbers whose tangents hold the direction v, so every partial carries
+// its own directional derivative. a single reverse sweep then yields the
+// gradient in the value part of the input adjoints and H v in their tangent
+// part, i.e. one product costs about as much as one gradient. tape and
+// workspace are reused between calls (e.g. the inner iterations of Newton-CG)
+template<typename T>
+struct HessianVectorProduct
+{
+    using Dual = forward::basic_dual<T>;
+    using Tape = reverse::Tape<Dual>;
+
+    // f receives the input variables and returns the output variable.
+    // returns f(x) and writes the gradient and H v
+    template<typename F>
+    auto operator()(F&& f, std::span<T const> x, std::span<T const> v, std::span<T> gradient, std::span<T> hv) -> T
+    {
+        assert(std::size(v) == std::size(x) && std::size(gradient) == std::size(x) && std::size(hv) == std::size(x));
+
+        variables.clear();
+        tape.rewind({});
+        for (auto i = 0UL; i < std::size(x); ++i) {
+            variables.push_back(tape.variable(Dual {.a = x[i], .b = v[i]}));
+        }
+
+        auto y = f(std::as_const(variables));
+        y.gradient_into(adjoints);
+        for (auto i = 0UL; i < std::size(x); ++i) {
+            auto const d = adjoints.wrt(variables[i]);
+            gradient[i] = d.a;
+            hv[i] = d.b;
+        }
+        return y.value.a;
+    }
+
+    Tape tape;
+    std::vector<typename Tape::Variable> variables;
+    Adjoints<Dual> adjoints;
+};
+
+}  // namespace reverse
+
+#endif
@@ -0,0 +1,455 @@
+#ifndef REVERSE_AD_DEMO_JACOBIAN_HPP
+#define REVERSE_AD_DEMO_JACOBIAN_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dual.hpp"
+#include "expr.hpp"
+#include "simd.hpp"
+#include "sparse.hpp"
+
+namespace reverse
+{
+
+enum class JacobianMode : std::uint8_t
+{
+    forward,  // ceil(n / L) evaluations over duals with L tangent lanes
+    reverse,  // one recording, ceil(m / K) vector-mode sweeps
+    compressed_forward,  // one evaluation per color of the column coloring
+    compressed_reverse,  // one sweep per color of the row coloring
+    mixed,  // dense rows by vector-mode sweeps, the other rows by compressed forward mode
+};
+
+// what the mode selection looks at, measured on one recording of f
+struct JacobianShape
+{
+    std::size_t n {0};  // inputs
+    std::size_t m {0};  // outputs
+    std::size_t length {0};  // tape nodes
+    std::size_t edges {0};  // tape edges
+    std::size_t row_colors {0};  // colors of the row coloring
+    std::size_t col_colors {0};  // colors of the column coloring
+    std::size_t dense_rows {0};  // mixed mode: rows left to the reverse sweeps
+    std::size_t sparse_colors {0};  // mixed mode: column colors of the other rows
+
+    // nodes and edges that the reverse sweeps of a strategy visit, summed over
+    // its sweeps. a sweep only visits the cone of its seeds, which for rows
+    // that depend on a small part of the tape is far less than the whole tape
+    struct Swept
+    {
+        std::size_t nodes {0};
+        std::size_t edges {0};
+    };
+    Swept reverse;  // ceil(m / K) sweeps over blocks of K rows
+    Swept compressed_reverse;  // one sweep per row color
+    Swept mixed;  // ceil(dense_rows / K) sweeps over the dense rows
+
+    // shape of a jacobian without a known sparsity pattern, for K lanes per
+    // reverse sweep: every sweep is assumed to visit the whole tape
+    static constexpr auto dense(std::size_t n, std::size_t m, std::size_t length, std::size_t edges, std::size_t k)
+        -> JacobianShape
+    {
+        auto const sweeps = (m + k - 1) / k;
+        Swept const all {sweeps * length, sweeps * edges};
+        return {n, m, length, edges, m, n, m, 0, all, {m * length, m * edges}, all};
+    }
+};
+
+// jacobian of f: R^n -> R^m with the cheapest of forward, reverse and mixed
+// mode. f is a generic callable that takes a vector of scalars (Var or dual)
+// and returns a random access range of them; it must work for both. the first
+// call records f on a tape, which gives m and the size of the tape, and picks
+// the mode with the lowest operation count (using the sparsity pattern when
+// the jacobian is sparse enough for coloring to pay off). the mode and pattern
+// are kept, along with every buffer, until the input dimension changes or
+// reset() is called, so f must keep the same structure between calls.
+// the result is column-major with leading dimension m, as in jacobian_into
+template<typename T = double, std::size_t L = 4, std::size_t K = 4>
+class Jacobian
+{
+  public:
+    using Mode = JacobianMode;
+    using Shape = JacobianShape;
+    using Lanes = forward::basic_dual<T, L>;
+    using Variable = typename Tape<T>::Variable;
+
+    // estimated number of scalar operations of a strategy. every evaluation
+    // of f computes each node once, and each of its tangent lanes costs a
+    // multiply per edge and an add per edge beyond the first of a node (the
+    // chain rule); a recording stores partials that mostly reuse the values it
+    // computes anyway. a reverse sweep visits the cone of its seeds, with the
+    // same multiply-adds per lane on the visited edges. lanes are paid for in
+    // full, so a pass over L lanes costs L times the tangent work even if some
+    // are unused
+    static constexpr auto cost(Mode mode, Shape const& s) -> double
+    {
+        auto const blocks = [](std::size_t k, std::size_t b) { return static_cast<double>((k + b - 1) / b); };
+        auto const tangent = [](std::size_t nodes, std::size_t edges, std::size_t lanes) {
+            auto const e = static_cast<double>(edges);
+            return static_cast<double>(lanes) * std::max(e, 2 * e - static_cast<double>(nodes));
+        };
+        auto const len = static_cast<double>(s.length);
+        auto const pass = [&](std::size_t lanes) { return len + tangent(s.length, s.edges, lanes); };
+        auto const sweep = [&](Shape::Swept w, std::size_t lanes) { return tangent(w.nodes, w.edges, lanes); };
+        auto const record = len;
+        switch (mode) {
+            case Mode::forward:
+                return blocks(s.n, L) * pass(L);
+            case Mode::reverse:
+                return record + sweep(s.reverse, K);
+            case Mode::compressed_forward:
+                return static_cast<double>(s.col_colors) * pass(1);
+            case Mode::compressed_reverse:
+                return record + sweep(s.compressed_reverse, 1);
+            case Mode::mixed:
+                return record + sweep(s.mixed, K) + static_cast<double>(s.sparse_colors) * pass(1);
+        }
+        return 0;
+    }
+
+    // the cheapest strategy; ties go to the earlier mode, forward first, which needs no tape
+    static constexpr auto choose(Shape const& s) -> Mode
+    {
+        constexpr std::array modes {
+            Mode::forward, Mode::reverse, Mode::compressed_forward, Mode::compressed_reverse, Mode::mixed};
+        auto best = Mode::forward;
+        for (auto mode : modes) {
+            if (cost(mode, s) < cost(best, s)) {
+                best = mode;
+            }
+        }
+        return best;
+    }
+
+    template<typename F>
+    auto operator()(F&& f, std::span<T const> x) -> std::span<T const>
+    {
+        if (!mode_ || std::size(x) != cols_) {
+            measure(f, x);
+            return jacobian_;
+        }
+        switch (*mode_) {
+            case Mode::forward:
+                forward(f, x);
+                break;
+            case Mode::reverse:
+            case Mode::compressed_reverse:
+            case Mode::mixed: {
+                auto const y = record(f, x);
+                backward(f, x, y);
+                break;
+            }
+            case Mode::compressed_forward:
+                compressed_forward(f, x, pattern_, col_colors_);
+                break;
+        }
+        return jacobian_;
+    }
+
+    // uses the given mode from the next measurement on instead of the cheapest
+    // one, e.g. to compare strategies. reset() goes back to choosing
+    auto pin(Mode mode) -> void
+    {
+        pinned_ = mode;
+        mode_.reset();
+    }
+
+    // forgets the chosen mode and sparsity pattern (buffers are kept)
+    auto reset() -> void
+    {
+        mode_.reset();
+        pinned_.reset();
+    }
+
+    [[nodiscard]] auto mode() const -> std::optional<Mode> { return mode_; }
+    [[nodiscard]] auto shape() const -> Shape const& { return shape_; }
+    [[nodiscard]] auto rows() const -> std::size_t { return rows_; }
+    [[nodiscard]] auto cols() const -> std::size_t { return cols_; }
+
+  private:
+    template<typename F>
+    auto record(F& f, std::span<T const> x)
+    {
+        inputs_.clear();
+        tape_.rewind({});
+        for (auto v : x) {
+            inputs_.push_back(tape_.variable(v));
+        }
+        return f(std::as_const(inputs_));
+    }
+
+    // records f once to learn m and the size of the tape, then picks the mode
+    // and computes this jacobian with it (reusing the recording in reverse mode)
+    template<typename F>
+    auto measure(F& f, std::span<T const> x) -> void
+    {
+        auto const y = record(f, x);
+        cols_ = std::size(x);
+        rows_ = std::size(y);
+        jacobian_.assign(rows_ * cols_, T {0});
+
+        shape_ = Shape::dense(cols_, rows_, tape_.length(), tape_.nodes.edges(), K);
+        pattern_ = sparsity(y, inputs_);
+        row_colors_ = color_rows(pattern_);
+        col_colors_ = color_rows(pattern_.transpose());
+        values_.assign(pattern_.nonzeros(), T {0});
+        shape_.row_colors = color_count(row_colors_);
+        shape_.col_colors = color_count(col_colors_);
+
+        std::vector<std::size_t> all(rows_);
+        std::iota(all.begin(), all.end(), 0UL);
+        shape_.reverse = swept(y, all);
+        auto by_color = all;
+        std::ranges::stable_sort(by_color, {}, [&](auto r) { return row_colors_[r]; });
+        shape_.compressed_reverse =
+            swept(y, by_color, [&](auto a, auto b, std::size_t) { return row_colors_[a] == row_colors_[b]; });
+        if (rows_ > 1 && cols_ > 1) {
+            split(y);
+        } else {
+            all_dense();
+        }
+        mode_ = pinned_ ? *pinned_ : choose(shape_);
+
+        if (*mode_ == Mode::forward) {
+            forward(f, x);
+        } else if (*mode_ == Mode::compressed_forward) {
+            compressed_forward(f, x, pattern_, col_colors_);
+        } else {
+            backward(f, x, y);
+        }
+    }
+
+    // picks the dense rows of mixed mode. a few dense rows force as many
+    // column colors as there are columns, while the rest of the jacobian may
+    // need only a handful. candidates are the rows with at least v nonzeros,
+    // for the largest row counts v, up to half of the rows
+    template<typename Y>
+    auto split(Y const& y) -> void
+    {
+        std::vector<std::size_t> counts(rows_);
+        for (auto r = 0UL; r < rows_; ++r) {
+            counts[r] = pattern_.row_ptr[r + 1] - pattern_.row_ptr[r];
+        }
+        auto thresholds = counts;
+        std::ranges::sort(thresholds, std::greater {});
+        auto const [first, last] = std::ranges::unique(thresholds);
+        thresholds.erase(first, last);
+
+        constexpr auto max_candidates {8UL};
+        all_dense();
+        auto best = cost(Mode::mixed, shape_);  // every row dense, i.e. reverse mode
+        auto best_threshold = std::size_t {0};
+        for (auto k = 0UL; k < std::min(max_candidates, std::size(thresholds)); ++k) {
+            auto const v = thresholds[k];
+            dense_.clear();
+            for (auto r = 0UL; r < rows_; ++r) {
+                if (counts[r] >= v) {
+                    dense_.push_back(r);
+                }
+            }
+            if (2 * std::size(dense_) > rows_) {
+                break;
+            }
+            drop_rows(v);
+            auto candidate = shape_;
+            candidate.dense_rows = std::size(dense_);
+            candidate.sparse_colors = color_count(color_rows(sparse_.transpose()));
+            candidate.mixed = swept(y, dense_);
+            if (auto const c = cost(Mode::mixed, candidate); c < best) {
+                best = c;
+                best_threshold = v;
+            }
+        }
+
+        if (best_threshold == 0) {
+            all_dense();
+            return;
+        }
+        dense_.clear();
+        for (auto r = 0UL; r < rows_; ++r) {
+            if (counts[r] >= best_threshold) {
+                dense_.push_back(r);
+            }
+        }
+        drop_rows(best_threshold);
+        sparse_colors_ = color_rows(sparse_.transpose());
+        shape_.dense_rows = std::size(dense_);
+        shape_.sparse_colors = color_count(sparse_colors_);
+        shape_.mixed = swept(y, dense_);
+    }
+
+    // mixed mode without a split: every row is dense, as in reverse mode
+    auto all_dense() -> void
+    {
+        dense_.resize(rows_);
+        std::iota(dense_.begin(), dense_.end(), 0UL);
+        sparse_ = Pattern {rows_, cols_, std::vector<std::size_t>(rows_ + 1, 0), {}, {}};
+        sparse_colors_.clear();
+        shape_.dense_rows = rows_;
+        shape_.sparse_colors = 0;
+        shape_.mixed = shape_.reverse;
+    }
+
+    // what the reverse sweeps over the given rows visit, one sweep per group
+    // of consecutive rows: blocks of K by default, as in jacobian_into. each
+    // sweep visits the union of the cones of its rows
+    template<typename Y, typename G>
+    auto swept(Y const& y, std::vector<std::size_t> const& rows, G same_sweep) -> typename Shape::Swept
+    {
+        typename Shape::Swept total;
+        for (auto first = 0UL; first < std::size(rows);) {
+            auto last = first + 1;
+            while (last < std::size(rows) && same_sweep(rows[first], rows[last], last - first)) {
+                ++last;
+            }
+            scalar_adjoints_.reset(tape_.length());
+            auto const index = [&](auto r) { return std::ranges::begin(y)[static_cast<std::ptrdiff_t>(r)].index; };
+            auto const seeds = std::span {rows}.subspan(first, last - first);
+            scalar_adjoints_.mark_cone(tape_.nodes, seeds | std::views::transform(index));
+            total.nodes += std::size(scalar_adjoints_.cone);
+            for (auto i : scalar_adjoints_.cone) {
+                total.edges += tape_.nodes.end(i) - tape_.nodes.begin(i);
+            }
+            first = last;
+        }
+        return total;
+    }
+
+    template<typename Y>
+    auto swept(Y const& y, std::vector<std::size_t> const& rows) -> typename Shape::Swept
+    {
+        return swept(y, rows, [](auto, auto, std::size_t k) { return k < K; });
+    }
+
+    // the pattern without the rows that have at least v nonzeros
+    auto drop_rows(std::size_t v) -> void
+    {
+        sparse_.rows = rows_;
+        sparse_.cols = cols_;
+        sparse_.row_ptr.assign(1, 0);
+        sparse_.col_idx.clear();
+        for (auto r = 0UL; r < rows_; ++r) {
+            auto const b = pattern_.row_ptr[r];
+            auto const e = pattern_.row_ptr[r + 1];
+            if (e - b < v) {
+                auto const first = pattern_.col_idx.begin() + static_cast<std::ptrdiff_t>(b);
+                auto const last = pattern_.col_idx.begin() + static_cast<std::ptrdiff_t>(e);
+                sparse_.col_idx.insert(sparse_.col_idx.end(), first, last);
+            }
+            sparse_.row_ptr.push_back(std::size(sparse_.col_idx));
+        }
+    }
+
+    template<typename F, typename Y>
+    auto backward(F& f, std::span<T const> x, Y const& y) -> void
+    {
+        if (*mode_ == Mode::reverse) {
+            jacobian_into(y, inputs_, adjoints_, jacobian_.data(), rows_);
+        } else if (*mode_ == Mode::compressed_reverse) {
+            sparse_jacobian_into(y, inputs_, pattern_, row_colors_, scalar_adjoints_, std::span {values_});
+            scatter(pattern_);
+        } else {
+            // dense rows from the recording, the rest from compressed forward passes
+            auto const d = std::size(dense_);
+            outputs_.clear();
+            for (auto r : dense_) {
+                outputs_.push_back(std::ranges::begin(y)[static_cast<std::ptrdiff_t>(r)]);
+            }
+            block_.resize(d * cols_);
+            jacobian_into(outputs_, inputs_, adjoints_, block_.data(), d);
+            for (auto c = 0UL; c < cols_; ++c) {
+                for (auto i = 0UL; i < d; ++i) {
+                    jacobian_[c * rows_ + dense_[i]] = block_[c * d + i];
+                }
+            }
+            if (sparse_.nonzeros() > 0) {
+                compressed_forward(f, x, sparse_, sparse_colors_);
+            }
+        }
+    }
+
+    template<typename F>
+    auto forward(F& f, std::span<T const> x) -> void
+    {
+        lanes_.resize(cols_);
+        for (auto c = 0UL; c < cols_; c += L) {
+            for (auto j = 0UL; j < cols_; ++j) {
+                lanes_[j] = j >= c && j < c + L ? Lanes::variable(x[j], j - c) : Lanes {x[j]};
+            }
+            auto const y = f(std::as_const(lanes_));
+            for (auto k = 0UL; k < std::min(L, cols_ - c); ++k) {
+                for (auto r = 0UL; r < rows_; ++r) {
+                    if constexpr (L == 1) {
+                        jacobian_[(c + k) * rows_ + r] = std::ranges::begin(y)[static_cast<std::ptrdiff_t>(r)].b;
+                    } else {
+                        jacobian_[(c + k) * rows_ + r] = std::ranges::begin(y)[static_cast<std::ptrdiff_t>(r)].b[k];
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename F>
+    auto compressed_forward(F& f, std::span<T const> x, Pattern const& p, std::vector<std::size_t> const& colors)
+        -> void
+    {
+        values_.resize(p.nonzeros());
+        sparse_jacobian_forward_into<T>(f, x, p, colors, seeds_, std::span {values_});
+        scatter(p);
+    }
+
+    // copies the compressed values into the dense column-major result
+    auto scatter(Pattern const& p) -> void
+    {
+        for (auto r = 0UL; r < p.rows; ++r) {
+            for (auto k = p.row_ptr[r]; k < p.row_ptr[r + 1]; ++k) {
+                jacobian_[p.col_idx[k] * rows_ + r] = values_[k];
+            }
+        }
+    }
+
+    Tape<T> tape_;
+    std::vector<Variable> inputs_;
+    std::vector<Variable> outputs_;  // mixed mode, the dense rows
+    Adjoints<simd::pack<T, K>> adjoints_;
+    Adjoints<T> scalar_adjoints_;  // compressed reverse mode
+    std::vector<Lanes> lanes_;
+    std::vector<forward::basic_dual<T>> seeds_;  // compressed forward mode
+    std::vector<T> jacobian_;
+    std::vector<T> block_;  // mixed mode, the dense rows as a column-major block
+    Pattern pattern_;
+    Pattern sparse_;  // mixed mode, the pattern without the dense rows
+    std::vector<std::size_t> row_colors_;
+    std::vector<std::size_t> col_colors_;
+    std::vector<std::size_t> sparse_colors_;  // column coloring of sparse_
+    std::vector<std::size_t> dense_;  // mixed mode, indices of the dense rows
+    std::vector<T> values_;  // compressed modes, one per pattern entry
+    Shape shape_;
+    std::optional<Mode> mode_;
+    std::optional<Mode> pinned_;
+    std::size_t rows_ {0};
+    std::size_t cols_ {0};
+};
+
+// one-off jacobian of f at x (column-major, m x n), see Jacobian
+template<typename F, typename T>
+auto jacobian(F&& f, std::vector<T> const& x) -> std::vector<T>
+{
+    Jacobian<T> driver;
+    auto const jac = driver(f, std::span<T const> {x});
+    return {jac.begin(), jac.end()};
+}
+
+}  // namespace reverse
+
+#endif
@@ -0,0 +1,485 @@
+#ifndef REVERSE_AD_DEMO_KERNELS_HPP
+#define REVERSE_AD_DEMO_KERNELS_HPP
+
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "simd.hpp"
+
+// fused elementary functions: every kernel returns the value together with the
+// first derivative, sharing the work between the two (sincos in one call, exp
+// as its own derivative, ...). forward duals, tape nodes and replay all go
+// through here, so each transcendental is evaluated once per operation
+namespace kernel
+{
+
+template<typename T>
+struct Eval
+{
+    T value;
+    T derivative;
+};
+
+// constexpr elementary functions for floating point arguments, used during
+// constant evaluation where <cmath> is not available. the argument is reduced
+// (by multiples of ln 2, pi / 2 or powers of two) and the remainder summed as
+// a series, which is accurate to a few ulp for moderate arguments. ln 2 and
+// pi / 2 are split into a head of 32 or 33 significant bits and a tail, so
+// the head times the multiple is exact in double and wider types; narrower
+// types are evaluated in double and rounded once
+namespace constant
+{
+
+template<typename T>
+concept wide = std::floating_point<T> && std::numeric_limits<T>::digits >= std::numeric_limits<double>::digits;
+
+template<wide T>
+constexpr auto log(T x) -> T
+{
+    constexpr T ln2_hi {6.93147180369123816490e-01};
+    constexpr T ln2_lo {1.90821492927058770002e-10};
+    constexpr T sqrt2 {1.41421356237309504880};
+    if (!(x >= 0)) {
+        return std::numeric_limits<T>::quiet_NaN();  // negative or nan
+    }
+    if (!(x > 0)) {
+        return -std::numeric_limits<T>::infinity();
+    }
+    if (x > std::numeric_limits<T>::max()) {
+        return x;
+    }
+    auto e = 0L;
+    for (; x > sqrt2; ++e) {
+        x *= T {0.5};
+    }
+    for (; x < sqrt2 / 2; --e) {
+        x *= T {2};
+    }
+    // log(x) = 2 atanh(z) with z = (x - 1) / (x + 1), |z| < 0.172
+    auto const z = (x - 1) / (x + 1);
+    auto const z2 = z * z;
+    auto term = z;
+    T sum {0};
+    for (auto n = 1; n < 40; n += 2) {
+        sum += term / static_cast<T>(n);
+        term *= z2;
+    }
+    return 2 * sum + static_cast<T>(e) * ln2_lo + static_cast<T>(e) * ln2_hi;
+}
+
+template<std::floating_point T>
+constexpr auto log(T x) -> T
+{
+    return static_cast<T>(log(static_cast<double>(x)));
+}
+
+// 2^k by repeated doubling or halving, exact while it stays a normal number
+template<std::floating_point T>
+constexpr auto pow2(long k) -> T
+{
+    T p {1};
+    for (; k > 0; --k) {
+        p *= T {2};
+    }
+    for (; k < 0; ++k) {
+        p *= T {0.5};
+    }
+    return p;
+}
+
+// arguments for which exp(x) neither overflows nor underflows to zero in T.
+// results down to half the smallest subnormal still round up to it
+template<std::floating_point T>
+struct exp_range
+{
+    static constexpr T upper {log(std::numeric_limits<T>::max())};
+    static constexpr T lower {log(std::numeric_limits<T>::denorm_min()) - log(T {2})};
+};
+
+template<wide T>
+constexpr auto exp(T x) -> T
+{
+    constexpr T ln2_hi {6.93147180369123816490e-01};
+    constexpr T ln2_lo {1.90821492927058770002e-10};
+    if (!(x >= x)) {
+        return x;  // nan
+    }
+    if (x > exp_range<T>::upper) {
+        return std::numeric_limits<T>::infinity();
+    }
+    if (x < exp_range<T>::lower) {
+        return T {0};
+    }
+    auto const k = static_cast<long>(x / (ln2_hi + ln2_lo) + (x < 0 ? T {-0.5} : T {0.5}));
+    auto const r = (x - static_cast<T>(k) * ln2_hi) - static_cast<T>(k) * ln2_lo;
+
+    T term {1};
+    T sum {1};
+    for (auto n = 1; n < 24; ++n) {
+        term *= r / static_cast<T>(n);
+        sum += term;
+    }
+    // scaled by 2^k in two normal factors, so that a subnormal result is only rounded once
+    auto const k1 = k / 2;
+    return sum * pow2<T>(k1) * pow2<T>(k - k1);
+}
+
+template<std::floating_point T>
+constexpr auto exp(T x) -> T
+{
+    return static_cast<T>(exp(static_cast<double>(x)));
+}
+
+template<wide T>
+constexpr auto sincos(T x) -> Eval<T>
+{
+    constexpr T pio2_hi {1.57079632673412561417e+00};
+    constexpr T pio2_lo {6.07710050650619224932e-11};
+    // pio2_hi has 33 significant bits, so k * pio2_hi is exact below this bound
+    constexpr T limit {0x1p19};
+    if (!(x >= std::numeric_limits<T>::lowest() && x <= std::numeric_limits<T>::max())) {  // nan or infinite
+        return {std::numeric_limits<T>::quiet_NaN(), std::numeric_limits<T>::quiet_NaN()};
+    }
+    if (!(x < limit && x > -limit)) {
+        using std::cos;
+        using std::sin;
+        return {sin(x), cos(x)};  // beyond the reduction, as in packed::sincos
+    }
+    auto const k = static_cast<long>(x / (pio2_hi + pio2_lo) + (x < 0 ? T {-0.5} : T {0.5}));
+    auto const r = (x - static_cast<T>(k) * pio2_hi) - static_cast<T>(k) * pio2_lo;  // |r| <= pi / 4
+
+    auto const r2 = r * r;
+    auto ts = r;
+    auto tc = T {1};
+    auto s = ts;
+    auto c = tc;
+    for (auto n = 1; n < 14; ++n) {
+        ts *= -r2 / static_cast<T>((2 * n) * (2 * n + 1));
+        tc *= -r2 / static_cast<T>((2 * n - 1) * (2 * n));
+        s += ts;
+        c += tc;
+    }
+    switch (((k % 4) + 4) % 4) {
+        case 1:
+            return {c, -s};
+        case 2:
+            return {-s, -c};
+        case 3:
+            return {-c, s};
+        default:
+            return {s, c};
+    }
+}
+
+template<std::floating_point T>
+constexpr auto sincos(T x) -> Eval<T>
+{
+    auto const [s, c] = sincos(static_cast<double>(x));
+    return {static_cast<T>(s), static_cast<T>(c)};
+}
+
+}  // namespace constant
+
+// sine and cosine of the same argument
+template<typename T>
+constexpr auto sincos(T const& x) -> Eval<T>
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        if (std::is_constant_evaluated()) {
+            return constant::sincos(x);
+        }
+    }
+#if defined(__GNUC__)
+    if constexpr (std::is_same_v<T, double>) {
+        double s {};
+        double c {};
+        __builtin_sincos(x, &s, &c);
+        return {s, c};
+    } else if constexpr (std::is_same_v<T, float>) {
+        float s {};
+        float c {};
+        __builtin_sincosf(x, &s, &c);
+        return {s, c};
+    }
+#endif
+    using std::cos;
+    using std::sin;
+    return {sin(x), cos(x)};
+}
+
+template<typename T>
+constexpr auto sin(T const& x) -> Eval<T>
+{
+    return sincos(x);
+}
+
+template<typename T>
+constexpr auto cos(T const& x) -> Eval<T>
+{
+    auto const [s, c] = sincos(x);
+    return {c, -s};
+}
+
+template<typename T>
+constexpr auto exp(T const& x) -> Eval<T>
+{
+    using std::exp;
+    if constexpr (std::is_floating_point_v<T>) {
+        if (std::is_constant_evaluated()) {
+            auto const e = constant::exp(x);
+            return {e, e};
+        }
+    }
+    auto const e = exp(x);
+    return {e, e};
+}
+
+template<typename T>
+constexpr auto log(T const& x) -> Eval<T>
+{
+    using std::log;
+    if constexpr (std::is_floating_point_v<T>) {
+        if (std::is_constant_evaluated()) {
+            return {constant::log(x), T(1) / x};
+        }
+    }
+    return {log(x), T(1) / x};
+}
+
+// vectorized kernels over packs of doubles. every step is a branch-free loop
+// over the lanes, which compilers emit as packed instructions, instead of one
+// libm call per lane: the argument is reduced as in the constant kernels, the
+// remainder goes through a fixed-degree polynomial, and special arguments
+// (nan, infinities, out of range) are patched in by lane-wise selects
+namespace packed
+{
+
+template<std::size_t N>
+using vec = simd::pack<double, N>;
+
+// adding 1.5 * 2^52 leaves an integer in the low mantissa bits
+constexpr double shift {0x1.8p52};
+
+// nearest integer, for |x| < 2^51
+template<std::size_t N>
+auto round(vec<N> const& x) -> vec<N>
+{
+    return (x + shift) - shift;
+}
+
+// 2^k for integral k in [-1022, 1023], built directly in the exponent field
+template<std::size_t N>
+auto pow2(vec<N> const& k) -> vec<N>
+{
+    vec<N> r;
+    for (auto i = 0UL; i < N; ++i) {
+        auto const bits = std::bit_cast<std::uint64_t>(k[i] + (shift + 1023.0));
+        r[i] = std::bit_cast<double>(bits << 52U);
+    }
+    return r;
+}
+
+template<std::size_t N>
+auto exp(vec<N> const& x) -> Eval<vec<N>>
+{
+    using range = constant::exp_range<double>;
+    constexpr double log2e {1.44269504088896338700e+00};
+    constexpr double ln2_hi {6.93147180369123816490e-01};
+    constexpr double ln2_lo {1.90821492927058770002e-10};
+
+    vec<N> c;  // clamped, so that k stays in range
+    for (auto i = 0UL; i < N; ++i) {
+        c[i] = x[i] < range::lower ? range::lower : (x[i] > range::upper ? range::upper : x[i]);
+    }
+    auto const k = round(c * log2e);
+    auto const r = (c - k * ln2_hi) - k * ln2_lo;  // |r| <= ln 2 / 2
+
+    // taylor series of exp(r) to degree 13 in horner form
+    vec<N> p {1.0};
+    for (auto n = 13; n > 0; --n) {
+        p = 1.0 + r * p * (1.0 / n);
+    }
+
+    // scaled by 2^k in two steps, so that both factors are normal numbers
+    auto const k1 = round(k * 0.5);
+    auto y = p * pow2(k1) * pow2(k - k1);
+    for (auto i = 0UL; i < N; ++i) {
+        y[i] = x[i] > range::upper ? std::numeric_limits<double>::infinity()
+            : x[i] < range::lower  ? 0.0
+            : std::isnan(x[i])     ? x[i]
+                                   : y[i];
+    }
+    return {y, y};
+}
+
+template<std::size_t N>
+auto log(vec<N> const& x) -> Eval<vec<N>>
+{
+    constexpr double ln2_hi {6.93147180369123816490e-01};
+    constexpr double ln2_lo {1.90821492927058770002e-10};
+    constexpr auto mantissa {0x000fffffffffffffULL};
+    constexpr auto one {0x3ff0000000000000ULL};
+    constexpr auto half_sqrt2 {0x3fe6a09e667f3bcdULL};  // sqrt(2) / 2
+
+    // x = m 2^e with m in [sqrt(2) / 2, sqrt(2)): offsetting the bits by
+    // 1 - sqrt(2) / 2 moves the exponent step to sqrt(2). subnormals are
+    // scaled up by 2^54 first
+    vec<N> y;
+    vec<N> e;
+    for (auto i = 0UL; i < N; ++i) {
+        auto const tiny = x[i] < std::numeric_limits<double>::min();
+        y[i] = tiny ? 0x1p54 : 1.0;
+        e[i] = tiny ? -1077.0 : -1023.0;  // exponent bias, and the scaling
+    }
+    y *= x;
+    vec<N> m;
+    for (auto i = 0UL; i < N; ++i) {
+        auto const bits = std::bit_cast<std::uint64_t>(y[i]) + (one - half_sqrt2);
+        e[i] += std::bit_cast<double>((bits >> 52U) | std::bit_cast<std::uint64_t>(0x1p52)) - 0x1p52;
+        m[i] = std::bit_cast<double>((bits & mantissa) + half_sqrt2);
+    }
+
+    // log(m) = 2 atanh(z) with z = (m - 1) / (m + 1), |z| < 0.172, to degree 21 in z
+    auto const z = (m - 1.0) / (m + 1.0);
+    auto const z2 = z * z;
+    vec<N> p {1.0 / 21};
+    for (auto n = 19; n > 0; n -= 2) {
+        p = 1.0 / n + z2 * p;
+    }
+    y = 2.0 * z * p + e * ln2_lo + e * ln2_hi;
+    for (auto i = 0UL; i < N; ++i) {
+        // nan or negative, then positive (finite or infinite), and zero is what remains
+        y[i] = !(x[i] >= 0) ? std::numeric_limits<double>::quiet_NaN()
+            : x[i] > 0      ? (x[i] <= std::numeric_limits<double>::max() ? y[i] : x[i])
+                            : -std::numeric_limits<double>::infinity();
+    }
+    return {y, 1.0 / x};
+}
+
+template<std::size_t N>
+auto sincos(vec<N> const& x) -> Eval<vec<N>>
+{
+    constexpr double two_over_pi {6.36619772367581382433e-01};
+    constexpr double pio2_hi {1.57079632673412561417e+00};
+    constexpr double pio2_lo {6.07710050650619224932e-11};
+    // pio2_hi has 33 significant bits, so k * pio2_hi is exact below this bound
+    constexpr double limit {0x1p19};
+
+    vec<N> c;  // lanes outside the reduction range are computed as 0 and redone below
+    for (auto i = 0UL; i < N; ++i) {
+        c[i] = std::abs(x[i]) < limit ? x[i] : 0.0;
+    }
+    auto const k = round(c * two_over_pi);
+    auto const r = (c - k * pio2_hi) - k * pio2_lo;  // |r| <= pi / 4
+    auto const r2 = r * r;
+
+    // taylor series of sin(r) and cos(r) to degree 21 and 20 in horner form
+    vec<N> ps {1.0};
+    vec<N> pc {1.0};
+    for (auto n = 10; n > 0; --n) {
+        ps = 1.0 - r2 * ps * (1.0 / ((2 * n) * (2 * n + 1)));
+        pc = 1.0 - r2 * pc * (1.0 / ((2 * n - 1) * (2 * n)));
+    }
+    ps *= r;
+
+    // quadrant k mod 4 swaps and negates the two
+    Eval<vec<N>> y;
+    for (auto i = 0UL; i < N; ++i) {
+        auto const q = std::bit_cast<std::uint64_t>(k[i] + shift) & 3U;
+        auto const s = (q & 1U) != 0 ? pc[i] : ps[i];
+        auto const t = (q & 1U) != 0 ? ps[i] : pc[i];
+        y.value[i] = (q & 2U) != 0 ? -s : s;
+        y.derivative[i] = ((q + 1) & 2U) != 0 ? -t : t;
+    }
+    for (auto i = 0UL; i < N; ++i) {
+        if (!(std::abs(x[i]) < limit)) {
+            auto const [s, t] = kernel::sincos(x[i]);
+            y.value[i] = s;
+            y.derivative[i] = t;
+        }
+    }
+    return y;
+}
+
+}  // namespace packed
+
+// batched variants. packs of doubles use the vectorized kernels above, packs
+// of floats are widened to double for them, which costs half the throughput
+// but keeps one set of polynomials. other lane types fill the value and
+// derivative packs lane by lane with the scalar kernel
+template<typename T, std::size_t N, typename F>
+auto lanes(simd::pack<T, N> const& x, F f) -> Eval<simd::pack<T, N>>
+{
+    Eval<simd::pack<T, N>> r {};
+    for (auto i = 0UL; i < N; ++i) {
+        auto const [v, d] = f(x[i]);
+        r.value[i] = v;
+        r.derivative[i] = d;
+    }
+    return r;
+}
+
+template<typename T, std::size_t N, typename V, typename F>
+auto batched(simd::pack<T, N> const& x, V vectorized, F scalar) -> Eval<simd::pack<T, N>>
+{
+    if constexpr (std::is_same_v<T, double>) {
+        return vectorized(x);
+    } else if constexpr (std::is_same_v<T, float>) {
+        packed::vec<N> w;
+        for (auto i = 0UL; i < N; ++i) {
+            w[i] = x[i];
+        }
+        auto const [v, d] = vectorized(w);
+        Eval<simd::pack<T, N>> r {};
+        for (auto i = 0UL; i < N; ++i) {
+            r.value[i] = static_cast<float>(v[i]);
+            r.derivative[i] = static_cast<float>(d[i]);
+        }
+        return r;
+    } else {
+        return lanes(x, scalar);
+    }
+}
+
+template<typename T, std::size_t N>
+auto sincos(simd::pack<T, N> const& x) -> Eval<simd::pack<T, N>>
+{
+    return batched(
+        x, [](auto const& y) { return packed::sincos(y); }, [](T const& y) { return sincos(y); });
+}
+
+template<typename T, std::size_t N>
+auto sin(simd::pack<T, N> const& x) -> Eval<simd::pack<T, N>>
+{
+    return sincos(x);
+}
+
+template<typename T, std::size_t N>
+auto cos(simd::pack<T, N> const& x) -> Eval<simd::pack<T, N>>
+{
+    auto const [s, c] = sincos(x);
+    return {c, -s};
+}
+
+template<typename T, std::size_t N>
+auto exp(simd::pack<T, N> const& x) -> Eval<simd::pack<T, N>>
+{
+    return batched(
+        x, [](auto const& y) { return packed::exp(y); }, [](T const& y) { return exp(y); });
+}
+
+template<typename T, std::size_t N>
+auto log(simd::pack<T, N> const& x) -> Eval<simd::pack<T, N>>
+{
+    return batched(
+        x, [](auto const& y) { return packed::log(y); }, [](T const& y) { return log(y); });
+}
+
+}  // namespace kernel
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef REVERSE_AD_DEMO_OBJECTIVE_HPP
+#define REVERSE_AD_DEMO_OBJECTIVE_HPP
+
+#include <algorithm>
+#include <ranges>
+#include <vector>
+
+#include "expr.hpp"
+
+namespace reverse
+{
+
+// accumulates f = sum_i r_i^2 and its gradient w.r.t. a set of parameters, one
+// residual at a time: each residual is swept with seed 2 r_i into a running
+// gradient and its nodes are popped right away. the tape never holds more than
+// the parameters plus one residual, no matter how many residuals are added
+template<typename Tp>
+struct SumOfSquares
+{
+    using Scalar = typename Tp::Scalar;
+    using Variable = typename Tp::Variable;
+
+    // records one leaf per initial parameter value
+    SumOfSquares(Tp& t, std::ranges::input_range auto&& x)
+        : tape(t)
+    {
+        for (auto v : x) {
+            parameters.push_back(tape.variable(v));
+        }
+        start = tape.mark();
+        gradient.assign(std::size(parameters), Scalar {0});
+    }
+
+    // folds residual r (recorded after the parameters) into the objective and
+    // discards its nodes. r and every variable derived from the parameters
+    // since the last call are invalid afterwards
+    auto add(Variable const& r) -> void
+    {
+        value += r.value * r.value;
+        r.gradient_into(adjoints, 2 * r.value, Sweep::sparse, start.nodes);
+        for (auto k = 0UL; k < std::size(parameters); ++k) {
+            gradient[k] += adjoints.wrt(parameters[k]);
+        }
+        tape.rewind(start);
+    }
+
+    // starts a new accumulation, keeping parameters and buffers
+    auto reset() -> void
+    {
+        tape.rewind(start);
+        value = Scalar {0};
+        std::ranges::fill(gradient, Scalar {0});
+    }
+
+    Tp& tape;
+    std::vector<Variable> parameters;
+    typename Tp::Mark start {};
+    Adjoints<Scalar> adjoints;  // reused by every residual sweep
+    std::vector<Scalar> gradient;
+    Scalar value {0};
+};
+
+}  // namespace reverse
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef REVERSE_AD_DEMO_PARALLEL_HPP
+#define REVERSE_AD_DEMO_PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "expr.hpp"
+
+namespace reverse
+{
+
+// evaluates rows (residuals, jacobian rows, ...) on a pool of worker threads.
+// a Tape is not thread-safe and a Var refers to its tape, so every worker owns
+// a tape and an adjoint workspace which are kept between calls: once they have
+// grown to the size of a chunk of rows, evaluation does not allocate. the
+// threads are started once and wait for work in between calls. variables must
+// never cross workers
+template<typename Tp = Tape<double>>
+class Workers
+{
+    using Scalar = typename Tp::Scalar;
+
+  public:
+    struct Slot
+    {
+        Tp tape;
+        Adjoints<Scalar> adjoints;
+    };
+
+    explicit Workers(std::size_t n = std::thread::hardware_concurrency())
+        : slots_(std::max(n, std::size_t {1}))
+        , errors_(std::size(slots_))
+    {
+        threads_.reserve(std::size(slots_) - 1);
+        for (auto w = 1UL; w < std::size(slots_); ++w) {
+            threads_.emplace_back([this, w](std::stop_token const& stop) { serve(stop, w); });
+        }
+    }
+
+    // the threads refer to the pool
+    Workers(Workers const&) = delete;
+    Workers(Workers&&) = delete;
+    auto operator=(Workers const&) -> Workers& = delete;
+    auto operator=(Workers&&) -> Workers& = delete;
+
+    ~Workers() = default;  // the threads are stopped and joined first, they are the last member
+
+    // splits [0, rows) into one contiguous chunk per worker and calls
+    // f(slot, first, last) for each of them concurrently. f typically writes
+    // its rows straight into a shared output buffer; the calling thread
+    // processes the first chunk. the first exception thrown by a worker is
+    // rethrown once all of them are done. not reentrant
+    template<typename F>
+    auto run(std::size_t rows, F&& f) -> void
+    {
+        auto const n = std::min(std::size(slots_), rows);
+        if (n == 0) {
+            return;
+        }
+        auto const chunk = (rows + n - 1) / n;
+        std::fill(errors_.begin(), errors_.end(), nullptr);
+
+        auto work = [&](std::size_t w) {
+            auto& slot = slots_[w];
+            try {
+                f(slot, std::min(rows, w * chunk), std::min(rows, (w + 1) * chunk));
+            } catch (...) {
+                errors_[w] = std::current_exception();
+            }
+            slot.tape.rewind({});  // keeps the memory blocks for the next call
+        };
+
+        {
+            std::scoped_lock lock {mutex_};
+            job_.context = &work;
+            job_.call = [](void const* context, std::size_t w) {
+                (*static_cast<decltype(work) const*>(context))(w);
+            };
+            active_ = n;
+            pending_ = n - 1;
+            ++generation_;
+        }
+        wake_.notify_all();
+        work(0);
+        {
+            std::unique_lock lock {mutex_};
+            done_.wait(lock, [this] { return pending_ == 0; });
+        }
+
+        for (auto const& e : errors_) {
+            if (e) {
+                std::rethrow_exception(e);
+            }
+        }
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return std::size(slots_); }
+
+  private:
+    // type-erased reference to the work of the current call, which lives on the
+    // stack of run() until every worker has reported back
+    struct Job
+    {
+        void const* context {nullptr};
+        void (*call)(void const*, std::size_t) {nullptr};
+    };
+
+    // worker loop: waits for a new call, takes its chunk if it has one
+    auto serve(std::stop_token const& stop, std::size_t w) -> void
+    {
+        auto seen = std::size_t {0};
+        std::unique_lock lock {mutex_};
+        while (wake_.wait(lock, stop, [&] { return generation_ != seen; })) {
+            seen = generation_;
+            if (w >= active_) {
+                continue;
+            }
+            auto const job = job_;
+            lock.unlock();
+            job.call(job.context, w);
+            lock.lock();
+            if (--pending_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<std::exception_ptr> errors_;  // one per worker, reset by every call
+
+    std::mutex mutex_;
+    std::condition_variable_any wake_;  // a new call was posted (or the pool stops)
+    std::condition_variable done_;  // the last worker of a call finished
+    Job job_;
+    std::size_t active_ {0};  // workers taking part in the current call
+    std::size_t pending_ {0};  // workers of the current call still running
+    std::size_t generation_ {0};  // number of calls so far
+
+    std::vector<std::jthread> threads_;
+};
+
+}  // namespace reverse
+
+#endif
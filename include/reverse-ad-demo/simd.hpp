@@ -0,0 +1,108 @@
+#ifndef REVERSE_AD_DEMO_SIMD_HPP
+#define REVERSE_AD_DEMO_SIMD_HPP
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+
+namespace simd
+{
+
+// fixed-width pack of N lanes with element-wise arithmetic. the lanes are
+// over-aligned and every operation is a plain loop over N, which compilers
+// turn into packed SIMD instructions. a scalar converts to a pack by
+// broadcasting, so generic code written as T {0} or T {1} does the right thing
+template<typename T, std::size_t N>
+struct pack
+{
+    static constexpr std::size_t lanes {N};
+
+    constexpr pack() = default;
+
+    constexpr pack(T x)  // NOLINT(google-explicit-constructor)
+    {
+        v.fill(x);
+    }
+
+    constexpr auto operator[](std::size_t i) -> T& { return v[i]; }
+    constexpr auto operator[](std::size_t i) const -> T const& { return v[i]; }
+
+    [[nodiscard]] static constexpr auto size() -> std::size_t { return N; }
+
+    constexpr auto operator+=(pack const& other) -> pack&
+    {
+        for (auto i = 0UL; i < N; ++i) {
+            v[i] += other.v[i];
+        }
+        return *this;
+    }
+
+    constexpr auto operator-=(pack const& other) -> pack&
+    {
+        for (auto i = 0UL; i < N; ++i) {
+            v[i] -= other.v[i];
+        }
+        return *this;
+    }
+
+    constexpr auto operator*=(pack const& other) -> pack&
+    {
+        for (auto i = 0UL; i < N; ++i) {
+            v[i] *= other.v[i];
+        }
+        return *this;
+    }
+
+    constexpr auto operator/=(pack const& other) -> pack&
+    {
+        for (auto i = 0UL; i < N; ++i) {
+            v[i] /= other.v[i];
+        }
+        return *this;
+    }
+
+    friend constexpr auto operator+(pack a, pack const& b) -> pack { return a += b; }
+    friend constexpr auto operator-(pack a, pack const& b) -> pack { return a -= b; }
+    friend constexpr auto operator*(pack a, pack const& b) -> pack { return a *= b; }
+    friend constexpr auto operator/(pack a, pack const& b) -> pack { return a /= b; }
+
+    friend constexpr auto operator+(pack a, T b) -> pack { return a += pack {b}; }
+    friend constexpr auto operator-(pack a, T b) -> pack { return a -= pack {b}; }
+    friend constexpr auto operator*(pack a, T b) -> pack { return a *= pack {b}; }
+    friend constexpr auto operator/(pack a, T b) -> pack { return a /= pack {b}; }
+
+    friend constexpr auto operator+(T a, pack const& b) -> pack { return pack {a} += b; }
+    friend constexpr auto operator-(T a, pack const& b) -> pack { return pack {a} -= b; }
+    friend constexpr auto operator*(T a, pack const& b) -> pack { return pack {a} *= b; }
+    friend constexpr auto operator/(T a, pack const& b) -> pack { return pack {a} /= b; }
+
+    friend constexpr auto operator-(pack a) -> pack
+    {
+        for (auto i = 0UL; i < N; ++i) {
+            a.v[i] = -a.v[i];
+        }
+        return a;
+    }
+
+    // lane-wise elementary functions, found by argument-dependent lookup
+    friend auto sin(pack a) -> pack { return a.apply([](T x) { return std::sin(x); }); }
+    friend auto cos(pack a) -> pack { return a.apply([](T x) { return std::cos(x); }); }
+    friend auto exp(pack a) -> pack { return a.apply([](T x) { return std::exp(x); }); }
+    friend auto log(pack a) -> pack { return a.apply([](T x) { return std::log(x); }); }
+
+    alignas(std::bit_ceil(N * sizeof(T))) std::array<T, N> v {};
+
+  private:
+    constexpr auto apply(auto f) -> pack&
+    {
+        for (auto i = 0UL; i < N; ++i) {
+            v[i] = f(v[i]);
+        }
+        return *this;
+    }
+};
+
+}  // namespace simd
+
+#endif
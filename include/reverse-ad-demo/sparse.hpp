@@ -0,0 +1,255 @@
+#ifndef REVERSE_AD_DEMO_SPARSE_HPP
+#define REVERSE_AD_DEMO_SPARSE_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <ranges>
+#include <span>
+#include <vector>
+
+#include "dual.hpp"
+#include "expr.hpp"
+
+namespace reverse
+{
+
+// compressed sparse row matrix. without values it describes a sparsity pattern
+template<typename T>
+struct CSR
+{
+    std::size_t rows {0};
+    std::size_t cols {0};
+    std::vector<std::size_t> row_ptr;  // row r has entries [row_ptr[r], row_ptr[r + 1])
+    std::vector<std::size_t> col_idx;
+    std::vector<T> values;
+
+    [[nodiscard]] auto nonzeros() const -> std::size_t { return std::size(col_idx); }
+
+    // swaps rows and columns (values are carried along when present)
+    [[nodiscard]] auto transpose() const -> CSR
+    {
+        CSR t;
+        t.rows = cols;
+        t.cols = rows;
+        t.row_ptr.assign(cols + 1, 0);
+        for (auto c : col_idx) {
+            ++t.row_ptr[c + 1];
+        }
+        for (auto c = 0UL; c < cols; ++c) {
+            t.row_ptr[c + 1] += t.row_ptr[c];
+        }
+        t.col_idx.resize(nonzeros());
+        t.values.resize(std::size(values));
+
+        auto next = t.row_ptr;
+        for (auto r = 0UL; r < rows; ++r) {
+            for (auto k = row_ptr[r]; k < row_ptr[r + 1]; ++k) {
+                auto const pos = next[col_idx[k]]++;
+                t.col_idx[pos] = r;
+                if (!values.empty()) {
+                    t.values[pos] = values[k];
+                }
+            }
+        }
+        return t;
+    }
+};
+
+using Pattern = CSR<std::uint8_t>;
+
+// jacobian sparsity pattern of outputs w.r.t. inputs: every node carries a
+// bitset of the inputs it depends on, propagated forward over the tape as the
+// union of the bitsets of its own inputs
+template<std::ranges::random_access_range O, std::ranges::random_access_range I>
+auto sparsity(O const& outputs, I const& inputs) -> Pattern
+{
+    constexpr auto bits {64UL};
+    Pattern p;
+    p.rows = std::size(outputs);
+    p.cols = std::size(inputs);
+    p.row_ptr.push_back(0);
+    if (p.rows == 0) {
+        return p;
+    }
+
+    auto const& tape = std::ranges::begin(outputs)->tape;
+    auto const& nodes = tape.nodes;
+    auto last = 0UL;
+    for (auto const& y : outputs) {
+        last = std::max(last, y.index);
+    }
+
+    auto const words = (p.cols + bits - 1) / bits;
+    std::vector<std::uint64_t> sets((last + 1) * words, 0);
+    auto c = 0UL;
+    for (auto const& x : inputs) {
+        if (x.index <= last) {
+            sets[x.index * words + c / bits] |= std::uint64_t {1} << (c % bits);
+        }
+        ++c;
+    }
+
+    for (auto i = 0UL; i <= last; ++i) {
+        auto* s = sets.data() + i * words;
+        for (auto j = nodes.begin(i), end = nodes.end(i); j < end; ++j) {
+            auto const* t = sets.data() + nodes.inputs[j] * words;
+            for (auto w = 0UL; w < words; ++w) {
+                s[w] |= t[w];
+            }
+        }
+    }
+
+    for (auto const& y : outputs) {
+        auto const* s = sets.data() + y.index * words;
+        for (auto col = 0UL; col < p.cols; ++col) {
+            if ((s[col / bits] >> (col % bits)) & 1U) {
+                p.col_idx.push_back(col);
+            }
+        }
+        p.row_ptr.push_back(std::size(p.col_idx));
+    }
+    return p;
+}
+
+// greedy distance-2 coloring of the rows of a pattern: two rows sharing a
+// column get different colors, so all rows of one color can be seeded
+// together in a single reverse sweep. color the transposed pattern to get a
+// column coloring for forward mode. returns the color of every row
+template<typename T>
+auto color_rows(CSR<T> const& p) -> std::vector<std::size_t>
+{
+    constexpr auto none {static_cast<std::size_t>(-1)};
+    auto const t = p.transpose();
+    std::vector<std::size_t> colors(p.rows, none);
+    std::vector<std::size_t> forbidden;  // forbidden[k] == r: color k is taken by a neighbor of r
+
+    for (auto r = 0UL; r < p.rows; ++r) {
+        for (auto k = p.row_ptr[r]; k < p.row_ptr[r + 1]; ++k) {
+            auto const c = p.col_idx[k];
+            for (auto q = t.row_ptr[c]; q < t.row_ptr[c + 1]; ++q) {
+                auto const color = colors[t.col_idx[q]];
+                if (color != none) {
+                    if (color >= std::size(forbidden)) {
+                        forbidden.resize(color + 1, none);
+                    }
+                    forbidden[color] = r;
+                }
+            }
+        }
+        auto color = 0UL;
+        while (color < std::size(forbidden) && forbidden[color] == r) {
+            ++color;
+        }
+        colors[r] = color;
+    }
+    return colors;
+}
+
+inline auto color_count(std::vector<std::size_t> const& colors) -> std::size_t
+{
+    return colors.empty() ? 0 : *std::ranges::max_element(colors) + 1;
+}
+
+// compressed reverse-mode jacobian: rows of one color are seeded together, so
+// the number of sweeps equals the number of colors instead of the number of
+// outputs. entries are recovered from the pattern since rows of one color
+// never share a column. writes one value per pattern entry, in pattern order;
+// colors is the row coloring of the pattern and the workspace is reused
+template<std::ranges::random_access_range O, std::ranges::random_access_range I, typename T>
+auto sparse_jacobian_into(O const& outputs,
+                          I const& inputs,
+                          Pattern const& pattern,
+                          std::vector<std::size_t> const& colors,
+                          Adjoints<T>& adjoints,
+                          std::span<T> values) -> void
+{
+    assert(std::size(values) == pattern.nonzeros() && std::size(colors) == pattern.rows);
+    if (pattern.rows == 0) {
+        return;
+    }
+
+    auto const& tape = std::ranges::begin(outputs)->tape;
+    auto const in = std::ranges::begin(inputs);
+    auto const out = std::ranges::begin(outputs);
+
+    for (auto color = 0UL; color < color_count(colors); ++color) {
+        adjoints.reset(tape.length());
+        auto last = 0UL;
+        for (auto r = 0UL; r < pattern.rows; ++r) {
+            if (colors[r] == color) {
+                adjoints.add(out[static_cast<std::ptrdiff_t>(r)].index, T {1});
+                last = std::max(last, out[static_cast<std::ptrdiff_t>(r)].index);
+            }
+        }
+        tape.backward(adjoints, last, Sweep::sparse);
+
+        for (auto r = 0UL; r < pattern.rows; ++r) {
+            if (colors[r] != color) {
+                continue;
+            }
+            for (auto k = pattern.row_ptr[r]; k < pattern.row_ptr[r + 1]; ++k) {
+                values[k] = adjoints[in[static_cast<std::ptrdiff_t>(pattern.col_idx[k])].index];
+            }
+        }
+    }
+}
+
+template<std::ranges::random_access_range O, std::ranges::random_access_range I>
+auto sparse_jacobian(O const& outputs, I const& inputs, Pattern const& pattern)
+{
+    using V = std::ranges::range_value_t<O>;
+    using T = decltype(V::value);
+
+    CSR<T> jac {pattern.rows, pattern.cols, pattern.row_ptr, pattern.col_idx, std::vector<T>(pattern.nonzeros())};
+    Adjoints<T> adjoints;
+    sparse_jacobian_into(outputs, inputs, pattern, color_rows(pattern), adjoints, std::span {jac.values});
+    return jac;
+}
+
+// compressed forward-mode jacobian of f: R^n -> R^m. f is called with a vector
+// of duals and returns a range of duals. columns of one color share a seed
+// direction, so f is evaluated once per color of the column coloring. writes
+// one value per pattern entry, in pattern order; colors is the column coloring
+// (the row coloring of the transposed pattern) and seeds is reused
+template<typename T, typename F>
+auto sparse_jacobian_forward_into(F&& f,
+                                  std::span<T const> x,
+                                  Pattern const& pattern,
+                                  std::vector<std::size_t> const& colors,
+                                  std::vector<forward::basic_dual<T>>& seeds,
+                                  std::span<T> values) -> void
+{
+    assert(std::size(x) == pattern.cols && std::size(colors) == pattern.cols);
+    assert(std::size(values) == pattern.nonzeros());
+
+    seeds.resize(std::size(x));
+    for (auto color = 0UL; color < color_count(colors); ++color) {
+        for (auto c = 0UL; c < std::size(x); ++c) {
+            seeds[c] = {.a = x[c], .b = T(colors[c] == color ? 1 : 0)};
+        }
+        auto const y = f(seeds);
+        for (auto r = 0UL; r < pattern.rows; ++r) {
+            for (auto k = pattern.row_ptr[r]; k < pattern.row_ptr[r + 1]; ++k) {
+                if (colors[pattern.col_idx[k]] == color) {
+                    values[k] = std::ranges::begin(y)[static_cast<std::ptrdiff_t>(r)].b;
+                }
+            }
+        }
+    }
+}
+
+template<typename T, typename F>
+auto sparse_jacobian_forward(F&& f, std::vector<T> const& x, Pattern const& pattern) -> CSR<T>
+{
+    CSR<T> jac {pattern.rows, pattern.cols, pattern.row_ptr, pattern.col_idx, std::vector<T>(pattern.nonzeros())};
+    std::vector<forward::basic_dual<T>> seeds;
+    sparse_jacobian_forward_into<T>(
+        f, std::span<T const> {x}, pattern, color_rows(pattern.transpose()), seeds, std::span {jac.values});
+    return jac;
+}
+
+}  // namespace reverse
+
+#endif
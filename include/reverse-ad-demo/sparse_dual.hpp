@@ -0,0 +1,199 @@
+#ifndef REVERSE_AD_DEMO_SPARSE_DUAL_HPP
+#define REVERSE_AD_DEMO_SPARSE_DUAL_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dual.hpp"
+#include "kernels.hpp"
+
+namespace forward
+{
+
+// sparse vector of (index, value) entries sorted by index. up to K entries
+// live inline in the object; beyond that they spill to a heap array, so the
+// tangents of the many intermediates that depend on a few inputs never allocate
+template<typename T, std::size_t K = 4>
+class SparseTangent
+{
+  public:
+    struct Entry
+    {
+        std::size_t index;
+        T value;
+    };
+
+    [[nodiscard]] auto entries() const -> std::span<Entry const>
+    {
+        return spilled() ? std::span<Entry const> {heap_} : std::span<Entry const> {inline_.data(), size_};
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return size_; }
+    [[nodiscard]] auto spilled() const -> bool { return size_ > K; }
+
+    // value at index i (zero when there is no entry)
+    [[nodiscard]] auto operator[](std::size_t i) const -> T
+    {
+        auto const e = entries();
+        auto it = std::ranges::lower_bound(e, i, {}, &Entry::index);
+        return it != e.end() && it->index == i ? it->value : T {0};
+    }
+
+    // entries must be appended in increasing index order
+    auto push_back(Entry e) -> void
+    {
+        if (size_ < K) {
+            inline_[size_] = e;
+        } else {
+            if (size_ == K) {
+                heap_.assign(inline_.begin(), inline_.end());
+            }
+            heap_.push_back(e);
+        }
+        ++size_;
+    }
+
+    // alpha * x + beta * y as a merge of the sorted entries, O(nnz(x) + nnz(y))
+    static auto combine(T alpha, SparseTangent const& x, T beta, SparseTangent const& y) -> SparseTangent
+    {
+        auto const p = x.entries();
+        auto const q = y.entries();
+        SparseTangent r;
+        auto i = 0UL;
+        auto j = 0UL;
+        while (i < std::size(p) && j < std::size(q)) {
+            if (p[i].index < q[j].index) {
+                r.push_back({p[i].index, alpha * p[i].value});
+                ++i;
+            } else if (q[j].index < p[i].index) {
+                r.push_back({q[j].index, beta * q[j].value});
+                ++j;
+            } else {
+                r.push_back({p[i].index, alpha * p[i].value + beta * q[j].value});
+                ++i;
+                ++j;
+            }
+        }
+        for (; i < std::size(p); ++i) {
+            r.push_back({p[i].index, alpha * p[i].value});
+        }
+        for (; j < std::size(q); ++j) {
+            r.push_back({q[j].index, beta * q[j].value});
+        }
+        return r;
+    }
+
+    auto operator*=(T alpha) -> SparseTangent&
+    {
+        auto scale = [&](auto& e) { e.value *= alpha; };
+        if (spilled()) {
+            std::ranges::for_each(heap_, scale);
+        } else {
+            std::for_each(inline_.begin(), inline_.begin() + static_cast<std::ptrdiff_t>(size_), scale);
+        }
+        return *this;
+    }
+
+  private:
+    std::array<Entry, K> inline_ {};
+    std::size_t size_ {0};
+    std::vector<Entry> heap_;
+};
+
+// dual number with a sparse tangent: b holds only the partials w.r.t. the
+// inputs a value actually depends on. arithmetic merges the sorted tangents,
+// so a full gradient of a sparse function costs time proportional to its
+// nonzeros instead of the input dimension
+template<typename T = double, std::size_t K = 4>
+struct sparse_dual
+{
+    using Scalar = T;
+    using Tangent = SparseTangent<T, K>;
+
+    T a {0};
+    Tangent b {};
+
+    // independent variable number i with value x
+    static auto variable(T x, std::size_t i) -> sparse_dual
+    {
+        sparse_dual d {x};
+        d.b.push_back({i, T {1}});
+        return d;
+    }
+
+    friend auto operator+(sparse_dual const& x, sparse_dual const& y) -> sparse_dual
+    {
+        return {.a = x.a + y.a, .b = Tangent::combine(T {1}, x.b, T {1}, y.b)};
+    }
+    friend auto operator+(Number auto c, sparse_dual x) -> sparse_dual { return std::move(x).shift(T(c)); }
+    friend auto operator+(sparse_dual x, Number auto c) -> sparse_dual { return std::move(x).shift(T(c)); }
+
+    friend auto operator-(sparse_dual const& x, sparse_dual const& y) -> sparse_dual
+    {
+        return {.a = x.a - y.a, .b = Tangent::combine(T {1}, x.b, T {-1}, y.b)};
+    }
+    friend auto operator-(Number auto c, sparse_dual x) -> sparse_dual { return std::move(x).scale(T {-1}).shift(T(c)); }
+    friend auto operator-(sparse_dual x, Number auto c) -> sparse_dual { return std::move(x).shift(-T(c)); }
+
+    friend auto operator*(sparse_dual const& x, sparse_dual const& y) -> sparse_dual
+    {
+        return {.a = x.a * y.a, .b = Tangent::combine(y.a, x.b, x.a, y.b)};
+    }
+    friend auto operator*(Number auto c, sparse_dual x) -> sparse_dual { return std::move(x).scale(T(c)); }
+    friend auto operator*(sparse_dual x, Number auto c) -> sparse_dual { return std::move(x).scale(T(c)); }
+
+    friend auto operator/(sparse_dual const& x, sparse_dual const& y) -> sparse_dual
+    {
+        auto const r = T {1} / y.a;
+        return {.a = x.a * r, .b = Tangent::combine(r, x.b, -x.a * r * r, y.b)};
+    }
+    friend auto operator/(Number auto c, sparse_dual x) -> sparse_dual
+    {
+        auto const r = T {1} / x.a;
+        x.b *= -T(c) * r * r;
+        x.a = T(c) * r;
+        return x;
+    }
+    friend auto operator/(sparse_dual x, Number auto c) -> sparse_dual { return std::move(x).scale(T {1} / T(c)); }
+
+    friend auto operator-(sparse_dual x) -> sparse_dual { return std::move(x).scale(T {-1}); }
+
+    // in-place updates for the constant operand cases, which keep the tangent sparsity
+    auto shift(T c) && -> sparse_dual&&
+    {
+        a += c;
+        return std::move(*this);
+    }
+
+    auto scale(T c) && -> sparse_dual&&
+    {
+        a *= c;
+        b *= c;
+        return std::move(*this);
+    }
+
+    auto sin() const -> sparse_dual { return chain(kernel::sin(a)); }
+    auto cos() const -> sparse_dual { return chain(kernel::cos(a)); }
+    auto exp() const -> sparse_dual { return chain(kernel::exp(a)); }
+    auto log() const -> sparse_dual { return chain(kernel::log(a)); }
+
+    // chain rule on a fused value/derivative pair evaluated at a
+    auto chain(kernel::Eval<T> const& f) const -> sparse_dual
+    {
+        sparse_dual r {f.value, b};
+        r.b *= f.derivative;
+        return r;
+    }
+
+    friend auto sin(sparse_dual const& x) -> sparse_dual { return x.sin(); }
+    friend auto cos(sparse_dual const& x) -> sparse_dual { return x.cos(); }
+    friend auto exp(sparse_dual const& x) -> sparse_dual { return x.exp(); }
+    friend auto log(sparse_dual const& x) -> sparse_dual { return x.log(); }
+};
+}  // namespace forward
+
+#endif
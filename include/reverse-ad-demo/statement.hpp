@@ -0,0 +1,303 @@
+#ifndef REVERSE_AD_DEMO_STATEMENT_HPP
+#define REVERSE_AD_DEMO_STATEMENT_HPP
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <type_traits>
+
+#include "expr.hpp"
+#include "kernels.hpp"
+
+// expression templates over variables: instead of pushing a node per operator,
+// a whole right-hand side is built as a compile-time expression whose values
+// and local partials live in registers. evaluate() then pushes a single n-ary
+// node with one edge per leaf occurrence, carrying the preaccumulated partial
+// of the statement w.r.t. that leaf. opt in by wrapping a variable with lazy():
+// operators between an expression and a variable, an expression or a number
+// yield expressions, while plain Var arithmetic is unchanged
+namespace reverse
+{
+
+template<typename E>
+concept Expression = requires(E const& e) {
+    typename E::Scalar;
+    typename E::TapeType;
+    { E::leaves } -> std::convertible_to<std::size_t>;
+    { e.value() } -> std::convertible_to<typename E::Scalar>;
+};
+
+// leaf referring to a recorded variable. it copies the node index and value,
+// so the expression stays valid after a temporary variable is gone
+template<typename T, typename Tp>
+struct Leaf
+{
+    using Scalar = T;
+    using TapeType = Tp;
+
+    static constexpr std::size_t leaves {1};
+
+    Tp* owner;
+    std::size_t index;
+    T v;
+
+    [[nodiscard]] auto value() const -> T { return v; }
+    [[nodiscard]] auto tape() const -> Tp& { return *owner; }
+
+    // hands the partial w of the statement w.r.t. this leaf to emit
+    template<typename F>
+    auto propagate(T w, F& emit) const -> void
+    {
+        emit(index, w);
+    }
+};
+
+// operation with one expression operand: d is its derivative w.r.t. the operand
+template<Expression E>
+struct Unary
+{
+    using Scalar = typename E::Scalar;
+    using TapeType = typename E::TapeType;
+
+    static constexpr std::size_t leaves {E::leaves};
+
+    E e;
+    Scalar v;
+    Scalar d;
+
+    [[nodiscard]] auto value() const -> Scalar { return v; }
+    [[nodiscard]] auto tape() const -> TapeType& { return e.tape(); }
+
+    template<typename F>
+    auto propagate(Scalar w, F& emit) const -> void
+    {
+        e.propagate(w * d, emit);
+    }
+};
+
+// operation with two expression operands and the derivatives w.r.t. each
+template<Expression L, Expression R>
+    requires std::same_as<typename L::TapeType, typename R::TapeType>
+struct Binary
+{
+    using Scalar = typename L::Scalar;
+    using TapeType = typename L::TapeType;
+
+    static constexpr std::size_t leaves {L::leaves + R::leaves};
+
+    L l;
+    R r;
+    Scalar v;
+    Scalar dl;
+    Scalar dr;
+
+    [[nodiscard]] auto value() const -> Scalar { return v; }
+    [[nodiscard]] auto tape() const -> TapeType& { return l.tape(); }
+
+    template<typename F>
+    auto propagate(Scalar w, F& emit) const -> void
+    {
+        l.propagate(w * dl, emit);
+        r.propagate(w * dr, emit);
+    }
+};
+
+template<typename T, typename Tp>
+auto lazy(Var<T, Tp> const& x) -> Leaf<T, Tp>
+{
+    return {&x.tape, x.index, x.value};
+}
+
+namespace detail
+{
+    template<typename X>
+    struct is_var : std::false_type
+    {
+    };
+
+    template<typename T, typename Tp>
+    struct is_var<Var<T, Tp>> : std::true_type
+    {
+    };
+
+    template<typename X>
+    constexpr auto operand(X const& x)
+    {
+        if constexpr (is_var<X>::value) {
+            return lazy(x);
+        } else {
+            return x;
+        }
+    }
+
+    template<typename L, typename R>
+    concept Operands = (Expression<L> && (Expression<R> || is_var<R>::value))
+        || (is_var<L>::value && Expression<R>);
+
+    template<typename E, typename C>
+    concept Constant = Expression<E> && std::constructible_from<typename E::Scalar, C> && !Expression<C>
+        && !is_var<C>::value;
+}  // namespace detail
+
+template<typename L, typename R>
+    requires detail::Operands<L, R>
+auto operator+(L const& l, R const& r)
+{
+    auto a = detail::operand(l);
+    auto b = detail::operand(r);
+    using T = typename decltype(a)::Scalar;
+    return Binary<decltype(a), decltype(b)> {a, b, a.value() + b.value(), T {1}, T {1}};
+}
+
+template<typename L, typename R>
+    requires detail::Operands<L, R>
+auto operator-(L const& l, R const& r)
+{
+    auto a = detail::operand(l);
+    auto b = detail::operand(r);
+    using T = typename decltype(a)::Scalar;
+    return Binary<decltype(a), decltype(b)> {a, b, a.value() - b.value(), T {1}, T {-1}};
+}
+
+template<typename L, typename R>
+    requires detail::Operands<L, R>
+auto operator*(L const& l, R const& r)
+{
+    auto a = detail::operand(l);
+    auto b = detail::operand(r);
+    return Binary<decltype(a), decltype(b)> {a, b, a.value() * b.value(), b.value(), a.value()};
+}
+
+template<typename L, typename R>
+    requires detail::Operands<L, R>
+auto operator/(L const& l, R const& r)
+{
+    auto a = detail::operand(l);
+    auto b = detail::operand(r);
+    auto const inv = 1 / b.value();
+    auto const v = a.value() * inv;
+    return Binary<decltype(a), decltype(b)> {a, b, v, inv, -v * inv};
+}
+
+template<Expression E, typename C>
+    requires detail::Constant<E, C>
+auto operator+(E const& e, C c)
+{
+    using T = typename E::Scalar;
+    return Unary<E> {e, e.value() + T(c), T {1}};
+}
+
+template<Expression E, typename C>
+    requires detail::Constant<E, C>
+auto operator+(C c, E const& e)
+{
+    return e + c;
+}
+
+template<Expression E, typename C>
+    requires detail::Constant<E, C>
+auto operator-(E const& e, C c)
+{
+    using T = typename E::Scalar;
+    return Unary<E> {e, e.value() - T(c), T {1}};
+}
+
+template<Expression E, typename C>
+    requires detail::Constant<E, C>
+auto operator-(C c, E const& e)
+{
+    using T = typename E::Scalar;
+    return Unary<E> {e, T(c) - e.value(), T {-1}};
+}
+
+template<Expression E, typename C>
+    requires detail::Constant<E, C>
+auto operator*(E const& e, C c)
+{
+    using T = typename E::Scalar;
+    return Unary<E> {e, e.value() * T(c), T(c)};
+}
+
+template<Expression E, typename C>
+    requires detail::Constant<E, C>
+auto operator*(C c, E const& e)
+{
+    return e * c;
+}
+
+template<Expression E, typename C>
+    requires detail::Constant<E, C>
+auto operator/(E const& e, C c)
+{
+    using T = typename E::Scalar;
+    auto const inv = 1 / T(c);
+    return Unary<E> {e, e.value() * inv, inv};
+}
+
+template<Expression E, typename C>
+    requires detail::Constant<E, C>
+auto operator/(C c, E const& e)
+{
+    using T = typename E::Scalar;
+    auto const v = T(c) / e.value();
+    return Unary<E> {e, v, -v / e.value()};
+}
+
+template<Expression E>
+auto operator-(E const& e)
+{
+    using T = typename E::Scalar;
+    return Unary<E> {e, -e.value(), T {-1}};
+}
+
+template<Expression E>
+auto sin(E const& e)
+{
+    auto const [v, d] = kernel::sin(e.value());
+    return Unary<E> {e, v, d};
+}
+
+template<Expression E>
+auto cos(E const& e)
+{
+    auto const [v, d] = kernel::cos(e.value());
+    return Unary<E> {e, v, d};
+}
+
+template<Expression E>
+auto exp(E const& e)
+{
+    auto const [v, d] = kernel::exp(e.value());
+    return Unary<E> {e, v, d};
+}
+
+template<Expression E>
+auto log(E const& e)
+{
+    auto const [v, d] = kernel::log(e.value());
+    return Unary<E> {e, v, d};
+}
+
+// records the statement as a single node with E::leaves edges and returns its
+// variable. the edges and partials are gathered on the stack
+template<Expression E>
+auto evaluate(E const& e) -> typename E::TapeType::Variable
+{
+    using T = typename E::Scalar;
+    std::array<std::size_t, E::leaves> inputs {};
+    std::array<T, E::leaves> partials {};
+    auto k = 0UL;
+    auto emit = [&](std::size_t i, T p) {
+        inputs[k] = i;
+        partials[k] = p;
+        ++k;
+    };
+    e.propagate(T {1}, emit);
+
+    auto& tape = e.tape();
+    return tape.record(Op::statement, e.value(), tape.push(inputs, partials));
+}
+
+}  // namespace reverse
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef REVERSE_AD_DEMO_STATIC_TAPE_HPP
+#define REVERSE_AD_DEMO_STATIC_TAPE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <ranges>
+#include <stdexcept>
+
+#include "expr.hpp"
+
+namespace reverse
+{
+
+// node storage with the interface of Nodes over fixed-size arrays: room for N
+// nodes and E edges, no allocation and no growth. every edge also records the
+// node it belongs to, so a sweep can walk the edges as one flat stream.
+// exceeding either capacity throws std::length_error, as StaticAdjoints does
+// for a tape longer than its workspace, and leaves the nodes recorded before.
+// the check is one well-predicted comparison per node and edge
+template<Arithmetic T, std::size_t N, std::size_t E>
+struct StaticNodes
+{
+    std::array<std::size_t, N> offsets {};
+    std::array<T, E> partials {};
+    std::array<std::size_t, E> inputs {};
+    std::array<std::size_t, E> outputs {};  // node of each edge
+    std::size_t count {0};
+    std::size_t edge_count {0};
+
+    auto size() const -> std::size_t { return count; }
+    auto edges() const -> std::size_t { return edge_count; }
+
+    auto begin(std::size_t i) const -> std::size_t { return i < count ? offsets[i] : edge_count; }
+    auto end(std::size_t i) const -> std::size_t { return i + 1 < count ? offsets[i + 1] : edge_count; }
+    auto arity(std::size_t i) const -> std::size_t { return end(i) - begin(i); }
+
+    auto add_node() -> std::size_t
+    {
+        if (count == N) {
+            throw std::length_error("StaticNodes: node capacity exceeded");
+        }
+        offsets[count] = edge_count;
+        return count++;
+    }
+
+    auto add_edge(std::size_t input, T partial) -> void
+    {
+        assert(count > 0);
+        if (edge_count == E) {
+            // drop the node being built, so the tape stays as it was before the push
+            edge_count = offsets[count - 1];
+            --count;
+            throw std::length_error("StaticNodes: edge capacity exceeded");
+        }
+        partials[edge_count] = partial;
+        inputs[edge_count] = input;
+        outputs[edge_count] = count - 1;
+        ++edge_count;
+    }
+
+    // truncates to the first n nodes, or pads with leaves
+    auto resize(std::size_t n)
+    {
+        if (n < count) {
+            edge_count = begin(n);
+            count = n;
+        }
+        while (count < n) {
+            add_node();
+        }
+    }
+
+    auto clear()
+    {
+        count = 0;
+        edge_count = 0;
+    }
+};
+
+// tape with a capacity fixed at compile time (N nodes, E edges), for small
+// functions of known shape such as a model evaluated at a single data point.
+// it offers the Var-facing interface of Tape, so the same user code records
+// on either one, but lives entirely on the stack. it keeps no trace and no
+// subexpression table, so there is no replay, no refined sweep and no sharing,
+// and comparisons are not guarded
+template<Arithmetic T, std::size_t N, std::size_t E = 2 * N>
+struct StaticTape
+{
+    using Scalar = T;
+    using Storage = T;
+    using Variable = Var<T, StaticTape>;
+
+    StaticNodes<T, N, E> nodes;
+
+    // leaf node (independent variable or constant)
+    auto push() -> std::size_t { return nodes.add_node(); }
+
+    // unary node
+    auto push(std::integral auto i, auto p) -> std::size_t
+    {
+        auto idx = nodes.add_node();
+        nodes.add_edge(i, T(p));
+        return idx;
+    }
+
+    // binary node
+    auto push(std::integral auto i0, auto p0, std::integral auto i1, auto p1) -> std::size_t
+    {
+        auto idx = nodes.add_node();
+        nodes.add_edge(i0, T(p0));
+        nodes.add_edge(i1, T(p1));
+        return idx;
+    }
+
+    // n-ary node with one edge per (input, partial) pair
+    template<std::ranges::input_range I, std::ranges::input_range P>
+    auto push(I&& inputs, P&& partials) -> std::size_t
+    {
+        auto idx = nodes.add_node();
+        auto p = std::ranges::begin(partials);
+        for (auto i : inputs) {
+            assert(p != std::ranges::end(partials));
+            nodes.add_edge(i, T(*p++));
+        }
+        return idx;
+    }
+
+    auto length() const -> std::size_t { return nodes.size(); }
+
+    // position on the tape, see mark() and rewind(). there are no guards, the
+    // member only mirrors Tape::Mark
+    struct Mark
+    {
+        std::size_t nodes;
+        std::size_t guards;
+    };
+
+    auto mark() const -> Mark { return {length(), 0}; }
+
+    // pops every node recorded after m
+    auto rewind(Mark m) -> void
+    {
+        assert(m.nodes <= length());
+        nodes.resize(m.nodes);
+    }
+
+    // scoped sub-recording, as Tape::Scope
+    struct Scope
+    {
+        explicit Scope(StaticTape& t)
+            : tape(t)
+            , mark(t.mark())
+        {
+        }
+
+        Scope(Scope const&) = delete;
+        Scope(Scope&&) = delete;
+        auto operator=(Scope const&) -> Scope& = delete;
+        auto operator=(Scope&&) -> Scope& = delete;
+
+        ~Scope() { tape.rewind(mark); }
+
+        StaticTape& tape;
+        Mark mark;
+    };
+
+    auto variable(T value) { return record(Op::leaf, value, push()); }
+
+    // propagates seeded adjoints from node last down to node first, as
+    // Tape::backward. edges are stored in node order and every input precedes
+    // its node, so walking the edge stream backwards is a valid reverse sweep.
+    // the trip count is the capacity E, known at compile time, so the compiler
+    // can unroll the sweep of a small tape completely; edges outside the range
+    // are masked. Sweep::cone is a sparse sweep here, which also only visits
+    // the nodes the output depends on, and Sweep::refined has no trace to
+    // recompute from
+    template<typename A>
+    auto backward(A& adjoints, std::size_t last, Sweep mode, std::size_t first = 0) const -> void
+    {
+        auto const lo = nodes.begin(first);
+        auto const hi = nodes.end(last);
+        auto const dense = mode == Sweep::dense;
+        for (auto j = E; j-- > 0;) {
+            if (j < lo || j >= hi) {
+                continue;
+            }
+            auto const i = nodes.outputs[j];
+            if (dense || adjoints.touched(i)) {
+                adjoints.add(nodes.inputs[j], nodes.partials[j] * adjoints[i]);
+            }
+        }
+    }
+
+    auto record(Op /*op*/, T value, std::size_t idx, T /*constant*/ = T {0}) -> Variable
+    {
+        return Variable {*this, value, idx};
+    }
+
+    auto branch(Cmp cmp, std::size_t /*lhs*/, T a, std::size_t /*rhs*/, T b) -> bool
+    {
+        return Guard<T>::compare(cmp, a, b);
+    }
+
+    auto clear() { nodes.clear(); }
+};
+
+// adjoint workspace for up to N nodes on the stack, with the interface of
+// Adjoints. reset() clears the entries in use, which is cheap at the sizes a
+// StaticTape is meant for
+template<Arithmetic T, std::size_t N>
+struct StaticAdjoints
+{
+    std::array<T, N> values {};
+    std::array<bool, N> stamps {};
+
+    auto reset(std::size_t n) -> void
+    {
+        if (n > N) {
+            throw std::length_error("StaticAdjoints: tape longer than the workspace");
+        }
+        std::fill_n(values.begin(), n, T {0});
+        std::fill_n(stamps.begin(), n, false);
+    }
+
+    auto operator[](std::size_t i) const -> T { return values[i]; }
+
+    auto touched(std::size_t i) const -> bool { return stamps[i]; }
+
+    auto add(std::size_t i, T v) -> void
+    {
+        stamps[i] = true;
+        values[i] += v;
+    }
+
+    template<typename Tp>
+    auto wrt(Var<T, Tp> const& v) const -> T
+    {
+        return values[v.index];
+    }
+
+    // the roots are enough: without a cone list, Tape::backward and
+    // StaticTape::backward handle Sweep::cone as a sparse sweep, which only
+    // follows touched nodes
+    template<typename Nd>
+    auto mark_cone(Nd const& /*nodes*/, std::ranges::input_range auto&& roots, std::size_t /*first*/ = 0) -> void
+    {
+        for (auto root : roots) {
+            stamps[root] = true;
+        }
+    }
+};
+
+}  // namespace reverse
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef REVERSE_AD_DEMO_TAYLOR_HPP
+#define REVERSE_AD_DEMO_TAYLOR_HPP
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+#include "dual.hpp"
+#include "kernels.hpp"
+
+namespace forward
+{
+
+// truncated univariate taylor polynomial of degree D: c[k] = f^(k)(t0) / k!
+// along the curve x(t) = x0 + t v. every operation propagates all D + 1
+// coefficients with the usual convolution recurrences, so the cost is O(D^2)
+// per operation, where nesting duals to get the same order costs O(2^D)
+template<typename T = double, std::size_t D = 3>
+struct taylor
+{
+    using Scalar = T;
+
+    static constexpr std::size_t degree {D};
+
+    std::array<T, D + 1> c {};
+
+    constexpr taylor() = default;
+    constexpr taylor(T x)  // NOLINT(google-explicit-constructor)
+        : c {x}
+    {
+    }
+
+    // independent variable at x moving in direction v
+    static auto variable(T x, T v = T {1}) -> taylor
+    {
+        taylor t {x};
+        if constexpr (D > 0) {
+            t.c[1] = v;
+        }
+        return t;
+    }
+
+    [[nodiscard]] auto value() const -> T { return c[0]; }
+
+    // k-th directional derivative, i.e. c[k] * k!
+    [[nodiscard]] auto derivative(std::size_t k) const -> T
+    {
+        auto d = c[k];
+        for (auto j = 2UL; j <= k; ++j) {
+            d *= static_cast<T>(j);
+        }
+        return d;
+    }
+
+    friend auto operator+(taylor const& a, taylor const& b) -> taylor
+    {
+        taylor r;
+        for (auto k = 0UL; k <= D; ++k) {
+            r.c[k] = a.c[k] + b.c[k];
+        }
+        return r;
+    }
+    friend auto operator+(Number auto x, taylor const& a) { return taylor {T(x)} + a; }
+    friend auto operator+(taylor const& a, Number auto x) { return a + taylor {T(x)}; }
+
+    auto operator+=(taylor const& other) -> taylor&
+    {
+        auto tmp = *this + other;
+        std::swap(*this, tmp);
+        return *this;
+    }
+
+    friend auto operator-(taylor const& a, taylor const& b) -> taylor
+    {
+        taylor r;
+        for (auto k = 0UL; k <= D; ++k) {
+            r.c[k] = a.c[k] - b.c[k];
+        }
+        return r;
+    }
+    friend auto operator-(Number auto x, taylor const& a) { return taylor {T(x)} - a; }
+    friend auto operator-(taylor const& a, Number auto x) { return a - taylor {T(x)}; }
+
+    friend auto operator-(taylor const& a) -> taylor
+    {
+        taylor r;
+        for (auto k = 0UL; k <= D; ++k) {
+            r.c[k] = -a.c[k];
+        }
+        return r;
+    }
+
+    // c_k = sum_j a_j b_{k-j}
+    friend auto operator*(taylor const& a, taylor const& b) -> taylor
+    {
+        taylor r;
+        for (auto k = 0UL; k <= D; ++k) {
+            T s {0};
+            for (auto j = 0UL; j <= k; ++j) {
+                s += a.c[j] * b.c[k - j];
+            }
+            r.c[k] = s;
+        }
+        return r;
+    }
+    friend auto operator*(Number auto x, taylor const& a) { return a * x; }
+    friend auto operator*(taylor const& a, Number auto x)
+    {
+        taylor r;
+        for (auto k = 0UL; k <= D; ++k) {
+            r.c[k] = a.c[k] * T(x);
+        }
+        return r;
+    }
+
+    // solves a = r * b for r: r_k = (a_k - sum_{j<k} r_j b_{k-j}) / b_0
+    friend auto operator/(taylor const& a, taylor const& b) -> taylor
+    {
+        taylor r;
+        for (auto k = 0UL; k <= D; ++k) {
+            auto s = a.c[k];
+            for (auto j = 0UL; j < k; ++j) {
+                s -= r.c[j] * b.c[k - j];
+            }
+            r.c[k] = s / b.c[0];
+        }
+        return r;
+    }
+    friend auto operator/(Number auto x, taylor const& a) { return taylor {T(x)} / a; }
+    friend auto operator/(taylor const& a, Number auto x) { return a * (T {1} / T(x)); }
+
+    // e' = e a' gives k e_k = sum_{j=1..k} j a_j e_{k-j}
+    auto exp() const -> taylor
+    {
+        taylor e;
+        e.c[0] = kernel::exp(c[0]).value;
+        for (auto k = 1UL; k <= D; ++k) {
+            T s {0};
+            for (auto j = 1UL; j <= k; ++j) {
+                s += static_cast<T>(j) * c[j] * e.c[k - j];
+            }
+            e.c[k] = s / static_cast<T>(k);
+        }
+        return e;
+    }
+
+    // a l' = a' gives l_k = (a_k - 1/k sum_{j=1..k-1} j l_j a_{k-j}) / a_0
+    auto log() const -> taylor
+    {
+        taylor l;
+        l.c[0] = kernel::log(c[0]).value;
+        for (auto k = 1UL; k <= D; ++k) {
+            T s {0};
+            for (auto j = 1UL; j < k; ++j) {
+                s += static_cast<T>(j) * l.c[j] * c[k - j];
+            }
+            l.c[k] = (c[k] - s / static_cast<T>(k)) / c[0];
+        }
+        return l;
+    }
+
+    // s' = c a' and c' = -s a' are coupled, so both series are built together
+    auto sincos() const -> std::pair<taylor, taylor>
+    {
+        taylor s;
+        taylor co;
+        auto const [s0, c0] = kernel::sincos(c[0]);
+        s.c[0] = s0;
+        co.c[0] = c0;
+        for (auto k = 1UL; k <= D; ++k) {
+            T ss {0};
+            T sc {0};
+            for (auto j = 1UL; j <= k; ++j) {
+                auto const ja = static_cast<T>(j) * c[j];
+                ss += ja * co.c[k - j];
+                sc += ja * s.c[k - j];
+            }
+            s.c[k] = ss / static_cast<T>(k);
+            co.c[k] = -sc / static_cast<T>(k);
+        }
+        return {s, co};
+    }
+
+    auto sin() const -> taylor { return sincos().first; }
+    auto cos() const -> taylor { return sincos().second; }
+
+    friend auto sin(taylor const& x) -> taylor { return x.sin(); }
+    friend auto cos(taylor const& x) -> taylor { return x.cos(); }
+    friend auto exp(taylor const& x) -> taylor { return x.exp(); }
+    friend auto log(taylor const& x) -> taylor { return x.log(); }
+};
+}  // namespace forward
+
+#endif
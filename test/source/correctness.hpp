@@ -8,12 +8,54 @@
 template<>
 auto boost::ut::cfg<boost::ut::override> = ut::runner<ut::reporter<>> {};
 
+#include "reverse-ad-demo/bfloat16.hpp"
 #include "reverse-ad-demo/dual.hpp"
+#include "reverse-ad-demo/eliminate.hpp"
 #include "reverse-ad-demo/expr.hpp"
+#include "reverse-ad-demo/hessian.hpp"
+#include "reverse-ad-demo/jacobian.hpp"
+#include "reverse-ad-demo/parallel.hpp"
+#include "reverse-ad-demo/sparse.hpp"
+#include "reverse-ad-demo/sparse_dual.hpp"
+#include "reverse-ad-demo/statement.hpp"
+#include "reverse-ad-demo/static_tape.hpp"
+#include "reverse-ad-demo/taylor.hpp"
 
 namespace reverse::test
 {
 
+// double that counts the arithmetic performed on it, to measure the actual
+// work of a strategy rather than estimate it
+struct counted
+{
+    double v {0};
+    static inline std::size_t ops {0};
+
+    counted() = default;
+    counted(double x)  // NOLINT(google-explicit-constructor)
+        : v(x)
+    {
+    }
+
+    friend auto operator+(counted a, counted b) -> counted { return ++ops, a.v + b.v; }
+    friend auto operator-(counted a, counted b) -> counted { return ++ops, a.v - b.v; }
+    friend auto operator*(counted a, counted b) -> counted { return ++ops, a.v * b.v; }
+    friend auto operator/(counted a, counted b) -> counted { return ++ops, a.v / b.v; }
+    friend auto operator-(counted a) -> counted { return -a.v; }
+
+    auto operator+=(counted b) -> counted& { return *this = *this + b; }
+    auto operator-=(counted b) -> counted& { return *this = *this - b; }
+    auto operator*=(counted b) -> counted& { return *this = *this * b; }
+    auto operator/=(counted b) -> counted& { return *this = *this / b; }
+
+    friend auto operator<=>(counted a, counted b) = default;
+
+    friend auto sin(counted a) -> counted { return ++ops, std::sin(a.v); }
+    friend auto cos(counted a) -> counted { return ++ops, std::cos(a.v); }
+    friend auto exp(counted a) -> counted { return ++ops, std::exp(a.v); }
+    friend auto log(counted a) -> counted { return ++ops, std::log(a.v); }
+};
+
 boost::ut::suite const correctness_test_suite = []() -> void
 {
     using namespace boost::ut;  // NOLINT
@@ -58,6 +100,21 @@ boost::ut::suite const correctness_test_suite = []() -> void
         expect(eq(gradient[1], x.value));
     };
 
+    "basic_dual<T, N> gives the whole gradient in one pass | x=0.5, y=4.2"_test = [&]() -> void
+    {
+        using Dual2 = forward::basic_dual<double, 2>;
+        auto constexpr a {0.5};
+        auto constexpr b {4.2};
+
+        auto x = Dual2::variable(a, 0);
+        auto y = Dual2::variable(b, 1);
+        auto z = x * y + x.sin() - 2 / y + (x / y).exp().log();
+
+        expect(eq(z.a, a * b + std::sin(a) - 2 / b + a / b));
+        expect(eq(z.b[0], b + std::cos(a) + 1 / b));
+        expect(eq(z.b[1], a + 2 / (b * b) - a / (b * b)));
+    };
+
     "sin(x) + cos(y) | x=2, y=3"_test = [&]
     {
         auto constexpr a {2.0};
@@ -148,6 +205,1017 @@ boost::ut::suite const correctness_test_suite = []() -> void
         expect(eq(g.wrt(z), -(a[0] + a[1]) / ((a[2] + a[3]) * (a[2] + a[3]))));
         expect(eq(g.wrt(w), -(a[0] + a[1]) / ((a[2] + a[3]) * (a[2] + a[3]))));
     };
+
+    "tape stores partials and inputs as separate streams"_test = [&]
+    {
+        Tape tape;
+        auto x = tape.variable(2.0);
+        auto y = tape.variable(3.0);
+        auto z = x * y;
+
+        expect(tape.length() == 3);
+        expect(tape.nodes.partials.size() == 2);
+        expect(tape.nodes.inputs.size() == 2);
+
+        auto n = tape.nodes[z.index];
+        expect(n.inputs[0] == x.index && n.inputs[1] == y.index);
+        expect(eq(n.partials[0], y.value) && eq(n.partials[1], x.value));
+    };
+
+    "nodes only store edges they actually have"_test = [&]
+    {
+        Tape tape;
+        auto x = tape.variable(2.0);
+        auto y = tape.variable(3.0);
+        auto s = x.sin();
+        auto p = x * y;
+
+        expect(tape.nodes.arity(x.index) == 0);
+        expect(tape.nodes.arity(y.index) == 0);
+        expect(tape.nodes.arity(s.index) == 1);
+        expect(tape.nodes.arity(p.index) == 2);
+        expect(tape.nodes.edges() == 3);
+
+        // scalar operands add no edge, so the sweep never touches node 0
+        std::array c {y + 1.0, 1.0 - y, y * 2.0, 2.0 / y, y / 2.0};
+        for (auto const& v : c) {
+            expect(tape.nodes.arity(v.index) == 1);
+        }
+        expect(tape.nodes.edges() == 3 + c.size());
+
+        reverse::Adjoints<double> adjoints;
+        (c[3] - c[4]).gradient_into(adjoints, 1.0, reverse::Sweep::sparse);
+        expect(!adjoints.touched(x.index));
+        expect(eq(adjoints.wrt(y), -2.0 / 9.0 - 0.5));
+    };
+
+    "n-ary sum and product | x=2, y=3, z=5"_test = [&]
+    {
+        constexpr std::array a {2.0, 3.0, 5.0};
+        Tape tape;
+        std::vector<Tape::Variable> v;
+        for (auto x : a) {
+            v.push_back(tape.variable(x));
+        }
+
+        auto s = reverse::sum(v);
+        auto p = reverse::product(v);
+        expect(tape.length() == a.size() + 2);
+        expect(tape.nodes.arity(p.index) == a.size());
+
+        expect(eq(s.value, 10.0));
+        expect(eq(p.value, 30.0));
+
+        auto gs = s.gradient();
+        auto gp = p.gradient();
+        for (auto i = 0UL; i < a.size(); ++i) {
+            expect(eq(gs.wrt(v[i]), 1.0));
+            expect(eq(gp.wrt(v[i]), 30.0 / a[i]));
+        }
+
+        // zero factors must not poison the other partials
+        auto z = tape.variable(0.0);
+        auto q = reverse::product(std::array {v[0], z, v[1]});
+        auto gq = q.gradient();
+        expect(eq(gq.wrt(z), 6.0));
+        expect(eq(gq.wrt(v[0]), 0.0));
+    };
+
+    "chunked tape keeps node addresses stable and frees blocks on clear"_test = [&]
+    {
+        Tape tape;
+        auto x = tape.variable(1.0);
+        auto const* first = &tape.nodes.offsets[0];
+
+        auto constexpr n {10'000};
+        std::vector terms {x};
+        for (auto i = 0; i < n; ++i) {
+            terms.push_back(terms.back() + x);
+        }
+        expect(first == &tape.nodes.offsets[0]);
+        expect(tape.nodes.partials.block_count() > 1);
+        expect(eq(terms.back().gradient().wrt(x), n + 1.0));
+
+        tape.clear();
+        expect(tape.length() == 0);
+        expect(tape.nodes.partials.block_count() == 0);
+    };
+
+    "pmr tape backed by a monotonic arena"_test = [&]
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        reverse::pmr::Tape<double> tape {&arena};
+
+        auto x = tape.variable(2.0);
+        auto y = tape.variable(3.0);
+        auto z = x * y + y.exp();
+        auto g = z.gradient();
+
+        expect(eq(g.wrt(x), 3.0));
+        expect(eq(g.wrt(y), 2.0 + std::exp(3.0)));
+    };
+
+    "gradient_into reuses the adjoint workspace"_test = [&]
+    {
+        Tape tape;
+        auto x = tape.variable(2.0);
+        auto y = tape.variable(3.0);
+        auto f = x * y;
+        auto h = x.sin() + y;
+
+        reverse::Adjoints<double> adjoints;
+        f.gradient_into(adjoints);
+        expect(eq(adjoints.wrt(x), 3.0));
+        expect(eq(adjoints.wrt(y), 2.0));
+
+        auto const* data = adjoints.values.data();
+        h.gradient_into(adjoints);
+        expect(data == adjoints.values.data());
+        expect(eq(adjoints.wrt(x), std::cos(2.0)));
+        expect(eq(adjoints.wrt(y), 1.0));
+        expect(eq(adjoints[f.index], 0.0));  // stale entry from the previous sweep
+
+        f.gradient_into(adjoints, 2.0);
+        expect(eq(adjoints.wrt(x), 6.0));
+    };
+
+    "replay re-evaluates a recorded tape at new inputs"_test = [&]
+    {
+        Tape tape;
+        tape.recording = true;
+
+        auto x = tape.variable(0.5);
+        auto y = tape.variable(4.2);
+        auto z = x * y + x.sin() + 2.0 / y - reverse::product(std::array {x, y, y});
+
+        auto constexpr a {1.5};
+        auto constexpr b {2.0};
+        tape.set_value(x.index, a);
+        tape.set_value(y.index, b);
+        expect(tape.replay());
+        expect(eq(tape.value(z.index), a * b + std::sin(a) + 2.0 / b - a * b * b));
+
+        auto g = z.gradient();
+        expect(eq(g.wrt(x), b + std::cos(a) - b * b));
+        expect(eq(g.wrt(y), a - 2.0 / (b * b) - 2 * a * b));
+    };
+
+    "replay detects a change in control flow"_test = [&]
+    {
+        Tape tape;
+        tape.recording = true;
+
+        auto x = tape.variable(2.0);
+        auto f = x > 1.0 ? x * x : x.exp();
+
+        tape.set_value(x.index, 3.0);
+        expect(tape.replay());
+        expect(eq(tape.value(f.index), 9.0));
+        expect(eq(f.gradient().wrt(x), 6.0));
+
+        tape.set_value(x.index, 0.5);
+        expect(!tape.replay());
+    };
+
+    "gradient of an early output only sweeps its dependency cone"_test = [&]
+    {
+        Tape tape;
+        auto x = tape.variable(2.0);
+        auto y = tape.variable(3.0);
+        auto u = tape.variable(5.0);
+        auto f = x * y + x.exp();
+
+        // unrelated work recorded after f
+        std::vector terms {u};
+        for (auto i = 0; i < 100; ++i) {
+            terms.push_back(terms.back() * u + x);
+        }
+
+        reverse::Adjoints<double> adjoints;
+        for (auto mode : {reverse::Sweep::dense, reverse::Sweep::sparse, reverse::Sweep::cone}) {
+            f.gradient_into(adjoints, 1.0, mode);
+            expect(eq(adjoints.wrt(x), 3.0 + std::exp(2.0)));
+            expect(eq(adjoints.wrt(y), 2.0));
+            expect(eq(adjoints.wrt(u), 0.0));
+        }
+        expect(adjoints.cone.size() == 5);  // x, y, x*y, exp(x), f
+
+        auto g = terms.back().gradient(reverse::Sweep::cone);
+        expect(eq(g.wrt(y), 0.0));
+        expect(eq(g.wrt(x), terms.back().gradient().wrt(x)));
+    };
+
+    "sparse jacobian from sparsity detection and coloring"_test = [&]
+    {
+        // banded function: y[i] = x[i] * x[i+1] + sin(x[i+2])
+        auto f = [](auto const& x) {
+            std::vector<std::decay_t<decltype(x[0])>> y;
+            for (auto i = 0UL; i + 2 < x.size(); ++i) {
+                y.push_back(x[i] * x[i + 1] + x[i + 2].sin());
+            }
+            return y;
+        };
+
+        std::vector<double> x0;
+        for (auto i = 0; i < 12; ++i) {
+            x0.push_back(0.1 * i + 0.3);
+        }
+
+        Tape tape;
+        std::vector<Tape::Variable> x;
+        for (auto v : x0) {
+            x.push_back(tape.variable(v));
+        }
+        auto y = f(x);
+
+        auto pattern = reverse::sparsity(y, x);
+        expect(pattern.rows == y.size() && pattern.cols == x.size());
+        expect(pattern.nonzeros() == 3 * y.size());
+        expect(reverse::color_count(reverse::color_rows(pattern)) == 3);
+        expect(reverse::color_count(reverse::color_rows(pattern.transpose())) == 3);
+
+        auto jr = reverse::sparse_jacobian(y, x, pattern);
+        auto jf = reverse::sparse_jacobian_forward(f, x0, pattern);
+        for (auto r = 0UL; r < y.size(); ++r) {
+            auto g = y[r].gradient();
+            for (auto k = pattern.row_ptr[r]; k < pattern.row_ptr[r + 1]; ++k) {
+                expect(eq(jr.values[k], g.wrt(x[pattern.col_idx[k]])));
+                expect(eq(jf.values[k], g.wrt(x[pattern.col_idx[k]])));
+            }
+        }
+    };
+
+    "tape over simd packs differentiates several points at once"_test = [&]
+    {
+        using Pack = simd::pack<double, 4>;
+        reverse::Tape<Pack> tape;
+
+        Pack a;
+        Pack b;
+        for (auto i = 0UL; i < Pack::size(); ++i) {
+            a[i] = 0.5 * static_cast<double>(i + 1);
+            b[i] = 4.2 - static_cast<double>(i);
+        }
+        auto x = tape.variable(a);
+        auto y = tape.variable(b);
+        auto z = x * y + x.sin() + 2.0 / y;
+        auto g = z.gradient();
+
+        for (auto i = 0UL; i < Pack::size(); ++i) {
+            expect(eq(z.value[i], a[i] * b[i] + std::sin(a[i]) + 2.0 / b[i]));
+            expect(eq(g.wrt(x)[i], b[i] + std::cos(a[i])));
+            expect(eq(g.wrt(y)[i], a[i] - 2.0 / (b[i] * b[i])));
+        }
+    };
+
+    "forward-over-reverse hessian-vector product"_test = [&]
+    {
+        auto f = [](auto const& x) { return x[0] * x[0] * x[1] + x[1].sin() * x[2]; };
+        std::array x {0.7, 1.3, -0.4};
+        std::array v {1.0, 2.0, 3.0};
+        std::array<double, 3> gradient {};
+        std::array<double, 3> hv {};
+
+        reverse::HessianVectorProduct<double> hvp;
+        for (auto repeat = 0; repeat < 2; ++repeat) {
+            auto y = hvp(f, std::span<double const> {x}, std::span<double const> {v}, gradient, hv);
+            expect(eq(y, x[0] * x[0] * x[1] + std::sin(x[1]) * x[2]));
+        }
+
+        expect(eq(gradient[0], 2 * x[0] * x[1]));
+        expect(eq(gradient[1], x[0] * x[0] + std::cos(x[1]) * x[2]));
+        expect(eq(gradient[2], std::sin(x[1])));
+
+        std::array<std::array<double, 3>, 3> h {{
+            {2 * x[1], 2 * x[0], 0.0},
+            {2 * x[0], -std::sin(x[1]) * x[2], std::cos(x[1])},
+            {0.0, std::cos(x[1]), 0.0},
+        }};
+        for (auto i = 0UL; i < 3; ++i) {
+            expect(eq(hv[i], h[i][0] * v[0] + h[i][1] * v[1] + h[i][2] * v[2]));
+        }
+    };
+
+    "fused kernels return value and derivative, scalar and batched"_test = [&]
+    {
+        simd::pack<double, 4> x;
+        for (auto i = 0UL; i < x.size(); ++i) {
+            x[i] = 0.3 + static_cast<double>(i);
+        }
+        auto const s = kernel::sin(x);
+        auto const c = kernel::cos(x);
+        auto const e = kernel::exp(x);
+        auto const l = kernel::log(x);
+        for (auto i = 0UL; i < x.size(); ++i) {
+            auto const [sv, sd] = kernel::sin(x[i]);
+            expect(eq(sv, std::sin(x[i])) && eq(sd, std::cos(x[i])));
+            expect(eq(s.value[i], sv) && eq(s.derivative[i], sd));
+            expect(eq(c.value[i], std::cos(x[i])) && eq(c.derivative[i], -std::sin(x[i])));
+            expect(eq(e.value[i], std::exp(x[i])) && eq(e.derivative[i], std::exp(x[i])));
+            expect(eq(l.value[i], std::log(x[i])) && eq(l.derivative[i], 1 / x[i]));
+        }
+    };
+
+    "vectorized pack kernels match libm"_test = [&]
+    {
+        constexpr auto inf {std::numeric_limits<double>::infinity()};
+        constexpr auto nan {std::numeric_limits<double>::quiet_NaN()};
+        auto ulps = [](double a, double b) {
+            if (std::isinf(b)) {
+                return std::isinf(a) && std::signbit(a) == std::signbit(b);
+            }
+            return std::abs(a - b) <= 4e-16 * std::abs(b);  // exact for a zero b
+        };
+
+        std::vector<double> points;
+        for (auto t = -750.0; t <= 750.0; t += 0.731) {
+            points.push_back(t);
+        }
+        for (auto t : {0.0, -0.0, 1e-310, 5e-324, 1e-300, 1e300, 1e7, -3e9, inf, -inf, nan}) {
+            points.push_back(t);
+        }
+        while (points.size() % 8 != 0) {
+            points.push_back(1.0);
+        }
+
+        for (auto k = 0UL; k < points.size(); k += 8) {
+            simd::pack<double, 8> x;
+            simd::pack<float, 8> xf;
+            for (auto i = 0UL; i < 8; ++i) {
+                x[i] = points[k + i];
+                xf[i] = static_cast<float>(x[i] / 8);  // inside the range of float exp
+            }
+            auto const [s, c] = kernel::sincos(x);
+            auto const e = kernel::exp(x);
+            auto const l = kernel::log(x);
+            auto const ef = kernel::exp(xf);
+            auto const sf = kernel::sin(xf);
+            for (auto i = 0UL; i < 8; ++i) {
+                auto const same = [&](double a, double b) { return std::isnan(b) ? std::isnan(a) : ulps(a, b); };
+                auto const near = [&](double a, double b) { return std::isnan(b) || std::abs(a - b) <= 1e-15; };
+                expect(near(s[i], std::sin(x[i])) && near(c[i], std::cos(x[i]))) << x[i];
+                expect(same(e.value[i], std::exp(x[i]))) << x[i];
+                expect(same(l.value[i], std::log(x[i]))) << x[i];
+                auto const ef_ref = std::exp(xf[i]);
+                expect(same(ef.value[i], ef_ref) || std::abs(ef.value[i] / ef_ref - 1) < 1e-6F) << xf[i];
+                expect(std::isnan(std::sin(xf[i])) || std::abs(sf.value[i] - std::sin(xf[i])) < 1e-6F) << xf[i];
+            }
+        }
+        expect(std::signbit(kernel::sin(simd::pack<double, 2> {-0.0}).value[0]));
+    };
+
+    "sparse tangents over a wide input space"_test = [&]
+    {
+        using Sparse = forward::sparse_dual<double, 4>;
+        constexpr auto n {100000UL};
+        std::vector<Sparse> x;
+        x.reserve(n);
+        for (auto i = 0UL; i < n; ++i) {
+            x.push_back(Sparse::variable(1.0 + 1e-5 * static_cast<double>(i), i));
+        }
+
+        auto y = x[5] * x[n - 1] + x[42].sin() / x[7] - 3 * x[5];
+        auto const e = y.b.entries();
+        expect(e.size() == 4 && !y.b.spilled());
+        expect(std::ranges::is_sorted(e, {}, &Sparse::Tangent::Entry::index));
+        expect(eq(y.b[5], x[n - 1].a - 3));
+        expect(eq(y.b[n - 1], x[5].a));
+        expect(eq(y.b[42], std::cos(x[42].a) / x[7].a));
+        expect(eq(y.b[7], -std::sin(x[42].a) / (x[7].a * x[7].a)));
+        expect(eq(y.b[6], 0.0));
+
+        // accumulating more than K inputs spills to the heap and stays sorted
+        auto s = Sparse {0.0};
+        for (auto i = 10UL; i > 0; --i) {
+            s = s + static_cast<double>(i) * x[i * 1000];
+        }
+        expect(s.b.size() == 10 && s.b.spilled());
+        expect(std::ranges::is_sorted(s.b.entries(), {}, &Sparse::Tangent::Entry::index));
+        for (auto i = 1UL; i <= 10; ++i) {
+            expect(eq(s.b[i * 1000], static_cast<double>(i)));
+        }
+    };
+
+    "constexpr duals and elementary functions"_test = [&]
+    {
+        constexpr auto close = [](double a, double b) { return (a > b ? a - b : b - a) <= 1e-15 * (1 + (b < 0 ? -b : b)); };
+
+        // derivative table of a calibration polynomial, baked at compile time
+        constexpr auto table = [] {
+            std::array<double, 5> d {};
+            for (auto i = 0UL; i < d.size(); ++i) {
+                auto const x = Dual::variable(static_cast<double>(i) / 2, 0);
+                d[i] = (1.5 + x * (-0.5 + x * (0.25 * x))).b;  // d/dx = 0.75 x^2 - 0.5
+            }
+            return d;
+        }();
+        static_assert(close(table[0], -0.5) && close(table[2], 0.25) && close(table[4], 2.5));
+
+        constexpr auto x = Dual::variable(0.8, 0);
+        constexpr auto y = (x.sin() * x.exp() + x.cos() / x).log();
+        static_assert(close(Dual::variable(1.0, 0).exp().a, 2.718281828459045));
+        static_assert(close(Dual::variable(2.0, 0).log().a, 0.6931471805599453));
+        static_assert(close(Dual::variable(3.141592653589793 / 6, 0).sin().a, 0.5));
+        static_assert(close(Dual::variable(3.141592653589793 / 3, 0).cos().b, -0.8660254037844386));
+
+        auto const rx = Dual::variable(0.8, 0);
+        auto const ry = (rx.sin() * rx.exp() + rx.cos() / rx).log();
+        expect(eq(y.a, ry.a) && eq(y.b, ry.b));
+
+        for (auto t = -40.0; t <= 40.0; t += 0.37) {
+            auto const [s, c] = kernel::constant::sincos(t);
+            expect(close(s, std::sin(t)) && close(c, std::cos(t)));
+            expect(std::abs(kernel::constant::exp(t) / std::exp(t) - 1) < 1e-14);
+            auto const u = std::abs(t) + 1e-3;
+            expect(close(kernel::constant::log(u), std::log(u)));
+        }
+
+        // float goes through the double kernels and is rounded once; large
+        // arguments leave the reduction for libm
+        for (auto t = -40.0F; t <= 40.0F; t += 0.37F) {
+            auto const [s, c] = kernel::constant::sincos(t);
+            expect(std::abs(s - std::sin(t)) < 1e-6F && std::abs(c - std::cos(t)) < 1e-6F);
+            expect(std::abs(kernel::constant::exp(t) / std::exp(t) - 1) < 1e-6F);
+            expect(std::abs(kernel::constant::log(std::abs(t) + 1e-3F) - std::log(std::abs(t) + 1e-3F)) < 1e-6F);
+        }
+        for (auto t : {0x1p19, -0x1p19, 1e7, -3e9, 1e300}) {
+            auto const [s, c] = kernel::constant::sincos(t);
+            expect(close(s, std::sin(t)) && close(c, std::cos(t))) << t;
+        }
+
+        // the overflow and underflow cutoffs follow the type, not those of double
+        static_assert(close(kernel::constant::exp_range<double>::upper, 709.782712893384));
+        static_assert(close(kernel::constant::exp_range<double>::lower, -745.1332191019412));
+        for (auto t : {1000.0L, 11000.0L, -1000.0L, -11000.0L}) {
+            expect(std::abs(kernel::constant::exp(t) / std::exp(t) - 1) < 1e-15L);
+        }
+        auto const big = kernel::constant::exp(100.0F);
+        auto const small = kernel::constant::exp(-110.0F);
+        auto const tiny = kernel::constant::exp(-744.9);
+        auto const denorm_min = std::numeric_limits<double>::denorm_min();
+        expect(std::isinf(big) && !std::signbit(big));
+        expect(std::fpclassify(small) == FP_ZERO && !std::signbit(small));
+        expect(std::fpclassify(tiny) == FP_SUBNORMAL && !(tiny < denorm_min) && !(tiny > denorm_min));
+    };
+
+    "taylor polynomials propagate higher-order derivatives"_test = [&]
+    {
+        using Taylor = forward::taylor<double, 6>;
+        auto const x0 {0.7};
+        auto const x = Taylor::variable(x0);
+
+        // exp(sin(x)) against hand-derived derivatives
+        auto const f = x.sin().exp();
+        auto const s = std::sin(x0);
+        auto const c = std::cos(x0);
+        auto const e = std::exp(s);
+        expect(eq(f.value(), e));
+        expect(eq(f.derivative(1), c * e));
+        expect(eq(f.derivative(2), (c * c - s) * e));
+        expect(eq(f.derivative(3), (c * c * c - 3 * s * c - c) * e));
+
+        // d^k/dx^k 1/x = (-1)^k k! / x^(k+1), d^k/dx^k log(x) = (-1)^(k-1) (k-1)! / x^k
+        auto const r = 1.0 / x;
+        auto const l = x.log();
+        auto factorial {1.0};
+        for (auto k = 1UL; k <= Taylor::degree; ++k) {
+            auto const sign = k % 2 == 0 ? 1.0 : -1.0;
+            expect(eq(l.derivative(k), -sign * factorial / std::pow(x0, k)));
+            factorial *= static_cast<double>(k);
+            expect(eq(r.derivative(k), sign * factorial / std::pow(x0, k + 1)));
+        }
+
+        // x^3 has three nonzero derivatives and exp(log(x)) is the identity
+        auto const cube = x * x * x;
+        auto const id = x.log().exp() - 2 * x + x;
+        for (auto k = 1UL; k <= Taylor::degree; ++k) {
+            expect(eq(cube.derivative(k), k == 1 ? 3 * x0 * x0 : k == 2 ? 6 * x0 : k == 3 ? 6.0 : 0.0));
+            expect(eq(id.derivative(k), 0.0));
+        }
+    };
+
+    "jacobian driver picks the cheaper mode"_test = [&]
+    {
+        using Driver = reverse::Jacobian<double, 4, 4>;
+        using Mode = reverse::JacobianMode;
+
+        // coloring pays off when either coloring needs few colors, and a split
+        // when only a few dense rows stand in the way of the column coloring
+        auto shape = reverse::JacobianShape::dense(40, 40, 100, 150, 4);
+        shape.col_colors = 3;
+        expect(Driver::choose(shape) == Mode::compressed_forward);
+        shape.row_colors = 1;
+        shape.compressed_reverse = {100, 150};  // one sweep over the whole tape
+        shape.col_colors = 40;
+        expect(Driver::choose(shape) == Mode::compressed_reverse);
+        shape.row_colors = 40;
+        shape.compressed_reverse = {4000, 6000};
+        shape.dense_rows = 2;
+        shape.mixed = {100, 150};
+        shape.sparse_colors = 3;
+        expect(Driver::choose(shape) == Mode::mixed);
+
+        // every row below reads a handful of nodes only, so a scalar sweep
+        // per row color beats the lanes that the other modes pay for in full
+        // tall: 2 inputs, 40 outputs
+        auto tall = [](auto const& x) {
+            std::vector<std::ranges::range_value_t<decltype(x)>> y;
+            for (auto i = 0; i < 40; ++i) {
+                y.push_back(x[0] * (x[1] * static_cast<double>(i + 1)).sin());
+            }
+            return y;
+        };
+        // wide: 40 inputs, 1 output
+        auto wide = [](auto const& x) {
+            std::vector<std::ranges::range_value_t<decltype(x)>> y {x[0] * x[0]};
+            for (auto i = 1UL; i < x.size(); ++i) {
+                y.push_back(y.back() + x[i] * x[i]);
+            }
+            return std::vector {y.back()};
+        };
+        // banded: 40 inputs, 40 outputs, tridiagonal
+        auto band = [](auto const& x) {
+            std::vector<std::ranges::range_value_t<decltype(x)>> y;
+            auto const n = x.size();
+            for (auto i = 0UL; i < n; ++i) {
+                y.push_back(x[(i + n - 1) % n] * x[i] + x[(i + 1) % n].sin());
+            }
+            return y;
+        };
+
+        Driver driver;
+        for (auto t : {0.3, 0.9}) {
+            std::vector x {1.5, t};
+            auto jac = driver(tall, std::span<double const> {x});
+            expect(driver.mode() == Mode::compressed_reverse && driver.rows() == 40 && driver.cols() == 2);
+            for (auto i = 0UL; i < 40; ++i) {
+                auto const k = static_cast<double>(i + 1);
+                expect(eq(jac[i], std::sin(k * t)));
+                expect(eq(jac[40 + i], 1.5 * k * std::cos(k * t)));
+            }
+        }
+
+        std::vector<double> w(40);
+        for (auto i = 0UL; i < w.size(); ++i) {
+            w[i] = 0.1 * static_cast<double>(i) - 1;
+        }
+        auto g = driver(wide, std::span<double const> {w});  // new input dimension: measured again
+        expect(driver.mode() == Mode::compressed_reverse && driver.rows() == 1);
+        for (auto i = 0UL; i < w.size(); ++i) {
+            expect(eq(g[i], 2 * w[i]));
+        }
+
+        driver.reset();
+        double const* result = nullptr;
+        for (auto repeat = 0; repeat < 2; ++repeat) {
+            auto const jac = driver(band, std::span<double const> {w});
+            expect(driver.mode() == Mode::compressed_reverse);
+            expect(repeat == 0 || jac.data() == result);  // buffers are kept across calls
+            result = jac.data();
+            auto const n = w.size();
+            for (auto r = 0UL; r < n; ++r) {
+                for (auto c = 0UL; c < n; ++c) {
+                    auto expected = 0.0;
+                    expected += c == (r + n - 1) % n ? w[r] : 0.0;
+                    expected += c == r ? w[(r + n - 1) % n] : 0.0;
+                    expected += c == (r + 1) % n ? std::cos(w[c]) : 0.0;
+                    expect(eq(jac[c * n + r], expected));
+                }
+            }
+        }
+
+        auto const dense = reverse::jacobian(tall, std::vector {1.5, 0.3});
+        expect(dense.size() == 80 && eq(dense[79], 1.5 * 40 * std::cos(40 * 0.3)));
+    };
+
+    "jacobian driver choice matches the measured work"_test = [&]
+    {
+        using Driver = reverse::Jacobian<counted, 4, 4>;
+        using Mode = reverse::JacobianMode;
+        constexpr std::array modes {
+            Mode::forward, Mode::reverse, Mode::compressed_forward, Mode::compressed_reverse, Mode::mixed};
+
+        // m outputs that share a chain of products of x[0], shared steps long;
+        // the first dense ones then read every input, the others x[i] and
+        // x[i + 1] only. with dense rows the jacobian is an arrowhead, whose
+        // dense rows and dense column defeat both colorings but not a split
+        auto family = [](std::size_t m, std::size_t dense, std::size_t shared) {
+            return [=](auto const& x) {
+                using V = std::ranges::range_value_t<decltype(x)>;
+                auto const n = x.size();
+                auto chain = [](auto self, V const& acc, std::size_t j, std::size_t end, auto const& step) -> V {
+                    return j == end ? acc : self(self, step(acc, j), j + 1, end, step);
+                };
+                auto const link = [&](V const& a, std::size_t) { return a * x[0].sin() + 0.5; };
+                auto const s = chain(chain, x[0], 0, shared, link);
+                std::vector<V> y;
+                for (auto i = 0UL; i < m; ++i) {
+                    if (i < dense) {
+                        auto const step = [&](V const& a, std::size_t j) { return a + x[j] * x[(j + i) % n].sin(); };
+                        y.push_back(chain(chain, s, 0, n, step));
+                    } else {
+                        y.push_back(s * x[i % n].sin() + x[(i + 1) % n]);
+                    }
+                }
+                return y;
+            };
+        };
+
+        // scalar operations of the second call with every mode pinned, against
+        // those of the mode the driver picks by itself
+        auto measure = [&](auto f, std::size_t n) {
+            std::vector<counted> x(n);
+            for (auto i = 0UL; i < n; ++i) {
+                x[i] = 0.1 * static_cast<double>(i + 1);
+            }
+            std::array<std::size_t, modes.size()> work {};
+            for (auto k = 0UL; k < modes.size(); ++k) {
+                Driver driver;
+                driver.pin(modes[k]);
+                driver(f, std::span<counted const> {x});
+                counted::ops = 0;
+                driver(f, std::span<counted const> {x});
+                work[k] = counted::ops;
+            }
+            Driver driver;
+            driver(f, std::span<counted const> {x});
+            auto const k = std::ranges::find(modes, *driver.mode()) - modes.begin();
+            auto const chosen = work[static_cast<std::size_t>(k)];
+            return std::pair {chosen, *std::ranges::min_element(work)};
+        };
+
+        // dense rows only, across the crossovers in n and in m; then tall,
+        // banded and arrowhead jacobians
+        std::vector<std::tuple<std::size_t, std::size_t, std::size_t, std::size_t>> cases;  // n, m, dense, shared
+        for (auto n : {2UL, 4UL, 6UL, 8UL, 12UL, 16UL}) {
+            cases.emplace_back(n, 4, 4, 20);
+        }
+        for (auto m : {2UL, 8UL, 16UL, 40UL}) {
+            cases.emplace_back(4, m, m, 20);
+        }
+        cases.emplace_back(2, 40, 0, 40);
+        cases.emplace_back(40, 40, 0, 0);
+        cases.emplace_back(40, 40, 2, 20);
+        cases.emplace_back(80, 80, 3, 40);
+        for (auto [n, m, dense, shared] : cases) {
+            auto const [chosen, best] = measure(family(m, dense, shared), n);
+            // within a fifth of the cheapest measured strategy
+            expect(static_cast<double>(chosen) <= 1.2 * static_cast<double>(best))
+                << "n =" << n << "m =" << m << "dense =" << dense << "shared =" << shared << ":" << chosen << "vs"
+                << best;
+        }
+
+        // every strategy, the split of mixed mode included, gives the same
+        // jacobian; the arrowhead is the one where the split pays off
+        std::vector<double> x(80);
+        for (auto i = 0UL; i < x.size(); ++i) {
+            x[i] = 0.025 * static_cast<double>(i) - 1;
+        }
+        auto const arrow = family(80, 3, 40);
+        reverse::Jacobian<double> reference;
+        reference.pin(Mode::forward);
+        auto const expected = reference(arrow, std::span<double const> {x});
+        for (auto mode : modes) {
+            reverse::Jacobian<double> driver;
+            driver.pin(mode);
+            for (auto repeat = 0; repeat < 2; ++repeat) {
+                auto const jac = driver(arrow, std::span<double const> {x});
+                expect(std::ranges::equal(jac, expected, eq));
+            }
+        }
+        reverse::Jacobian<double> driver;
+        driver(arrow, std::span<double const> {x});
+        expect(driver.mode() == Mode::mixed && driver.shape().dense_rows == 3);
+
+        // and the crossover between forward and reverse sweeps in m
+        driver.reset();
+        driver(family(40, 40, 20), std::span<double const> {x}.first(4));
+        expect(driver.mode() == Mode::forward);
+        driver.reset();
+        driver(family(2, 2, 20), std::span<double const> {x}.first(4));
+        expect(driver.mode() == Mode::compressed_reverse);
+    };
+
+    "mixed-precision tapes with full-precision refinement"_test = [&]
+    {
+        auto record = [](auto& tape) {
+            tape.recording = true;
+            auto x = tape.variable(0.7);
+            auto y = tape.variable(1.9);
+            std::vector terms {x, y, x};
+            auto f = (x * y + x.sin() * 1.1).exp() / (y.log() + 3.0) + reverse::product(terms) - 0.3 - y / 7.0;
+            return std::tuple {x, y, f};
+        };
+        auto rel = [](double a, double b) { return std::abs(a / b - 1); };
+
+        Tape reference;
+        auto [x0, y0, f0] = record(reference);
+        auto g = f0.gradient();
+        auto const gx = g.wrt(x0);
+        auto const gy = g.wrt(y0);
+
+        reverse::MixedTape<double, float> single;
+        auto [x1, y1, f1] = record(single);
+        expect(eq(f1.value, f0.value));
+        auto g1 = f1.gradient();
+        expect(rel(g1.wrt(x1), gx) < 1e-6 && rel(g1.wrt(y1), gy) < 1e-6);
+        auto r1 = f1.gradient(reverse::Sweep::refined);
+        expect(rel(r1.wrt(x1), gx) < 1e-14 && rel(r1.wrt(y1), gy) < 1e-14);
+
+        reverse::MixedTape<double, reverse::bfloat16> half;
+        static_assert(sizeof(reverse::bfloat16) == 2);
+        auto [x2, y2, f2] = record(half);
+        auto g2 = f2.gradient(reverse::Sweep::sparse);
+        expect(rel(g2.wrt(x2), gx) < 1e-2 && rel(g2.wrt(y2), gy) < 1e-2);
+        auto r2 = f2.gradient(reverse::Sweep::refined);
+        expect(rel(r2.wrt(x2), gx) < 1e-14 && rel(r2.wrt(y2), gy) < 1e-14);
+
+        // the workspace keeps its scratch buffer across refined sweeps
+        reverse::Adjoints<double> adjoints;
+        f2.gradient_into(adjoints, 1.0, reverse::Sweep::refined);
+        auto const* scratch = adjoints.exact.data();
+        f2.gradient_into(adjoints, 1.0, reverse::Sweep::refined);
+        expect(scratch != nullptr && adjoints.exact.data() == scratch && eq(adjoints.wrt(x2), gx));
+
+        // without a trace there is nothing to refine, the stored partials are used
+        half.recording = false;
+        half.trace.clear();
+        auto s2 = f2.gradient(reverse::Sweep::refined);
+        expect(eq(s2.wrt(x2), g2.wrt(x2)) && eq(s2.wrt(y2), g2.wrt(y2)));
+
+        // rounding to nearest even
+        expect(reverse::bfloat16 {1.0 + 0x1p-8}.bits == 0x3f80U);
+        expect(reverse::bfloat16 {1.0 + 0x3p-8}.bits == 0x3f82U);
+    };
+
+    "expression templates push one node per statement"_test = [&]
+    {
+        Tape tape;
+        auto x = tape.variable(0.6);
+        auto y = tape.variable(1.7);
+
+        auto const before = tape.length();
+        auto rhs = sin(lazy(x) * y) + exp(x / lazy(y)) * 2.0 - log(lazy(y)) / x + 3.0 / lazy(x) - lazy(x) * x;
+        auto z = reverse::evaluate(rhs);
+        expect(tape.length() == before + 1);
+        expect(tape.nodes.arity(z.index) == decltype(rhs)::leaves && decltype(rhs)::leaves == 9);
+
+        auto w = (x * y).sin() + (x / y).exp() * 2.0 - y.log() / x + 3.0 / x - x * x;
+        expect(eq(z.value, w.value));
+        auto gz = z.gradient();
+        auto gw = w.gradient();
+        expect(eq(gz.wrt(x), gw.wrt(x)) && eq(gz.wrt(y), gw.wrt(y)));
+
+        // statements compose with the eager operators
+        auto u = reverse::evaluate(-lazy(z) * z + 1) * x;
+        auto gu = u.gradient();
+        expect(eq(gu.wrt(x), (1 - z.value * z.value) + x.value * -2 * z.value * gz.wrt(x)));
+
+        // temporary variables may end the full-expression before the statement is evaluated
+        auto e = lazy(x) * (x + y);
+        auto v = reverse::evaluate(e);
+        auto gv = v.gradient();
+        expect(eq(v.value, x.value * (x.value + y.value)));
+        expect(eq(gv.wrt(x), 2 * x.value + y.value) && eq(gv.wrt(y), x.value));
+    };
+
+    "static tape matches the dynamic tape"_test = [&]
+    {
+        auto f = [](auto& tape) {
+            auto x = tape.variable(0.4);
+            auto y = tape.variable(2.3);
+            std::vector terms {x, y, x.exp()};
+            auto z = reverse::product(terms) + reverse::sum(terms) - (x / y).sin() * 3.0 + 1.0 / y;
+            return std::tuple {x, y, z};
+        };
+
+        Tape tape;
+        auto [x, y, z] = f(tape);
+        auto g = z.gradient();
+
+        reverse::StaticTape<double, 16> fixed;
+        auto [sx, sy, sz] = f(fixed);
+        expect(fixed.length() == tape.length() && fixed.nodes.edges() == tape.nodes.edges());
+        expect(eq(sz.value, z.value));
+
+        reverse::StaticAdjoints<double, 16> adjoints;
+        for (auto mode : {reverse::Sweep::dense, reverse::Sweep::sparse, reverse::Sweep::cone}) {
+            sz.gradient_into(adjoints, 1.0, mode);
+            expect(eq(adjoints.wrt(sx), g.wrt(x)) && eq(adjoints.wrt(sy), g.wrt(y)));
+        }
+
+        // the capacity is exact, and a scope gives its nodes and edges back
+        reverse::StaticTape<double, 4, 1> small;
+        auto a = small.variable(1.0);
+        auto b = small.variable(2.0);
+        for (auto repeat = 0; repeat < 2; ++repeat) {
+            decltype(small)::Scope scope {small};
+            auto c = b.sin();
+            auto d = small.variable(3.0);
+            expect(small.length() == 4 && small.nodes.edges() == 1);
+            expect(eq(c.gradient().wrt(b), std::cos(2.0)) && eq(d.gradient().wrt(a), 0.0));
+        }
+        expect(small.length() == 2 && small.nodes.edges() == 0 && eq(a.value, 1.0));
+
+        // running out of nodes or edges is an error, not an overrun
+        expect(throws<std::length_error>([&] { static_cast<void>(a * b); }));
+        expect(small.length() == 2 && small.nodes.edges() == 0);
+        auto c = a.sin();
+        expect(throws<std::length_error>([&] { static_cast<void>(b.sin()); }));
+        expect(small.length() == 3 && eq(c.gradient().wrt(a), std::cos(1.0)));
+        expect(nothrow([&] { static_cast<void>(small.variable(3.0)); }));
+        expect(throws<std::length_error>([&] { static_cast<void>(small.variable(4.0)); }));
+    };
+
+    "vertex elimination preserves derivatives with fewer edges"_test = [&]
+    {
+        auto f = [](Tape& tape) {
+            auto x = tape.variable(0.7);
+            auto y = tape.variable(1.9);
+            auto u = (x * y).sin().exp() * 2.0;
+            auto v = (u + x).log() / y;
+            std::array outputs {u * v, (v - x).cos() + u};
+            return std::tuple {x, y, outputs};
+        };
+
+        for (auto mode : {reverse::Elimination::greedy, reverse::Elimination::full}) {
+            Tape reference;
+            auto [rx, ry, rf] = f(reference);
+
+            Tape tape;
+            tape.recording = true;
+            auto [x, y, outputs] = f(tape);
+            auto const stats = reverse::eliminate(tape, outputs, mode);
+            expect(stats.edges_before == reference.nodes.edges());
+            expect(stats.edges_after == tape.nodes.edges() && stats.edges_after < stats.edges_before);
+            expect(stats.eliminated > 0 && tape.length() == reference.length());
+
+            for (auto k = 0UL; k < outputs.size(); ++k) {
+                auto r = rf[k].gradient();
+                for (auto sweep : {reverse::Sweep::dense, reverse::Sweep::sparse, reverse::Sweep::cone,
+                                   reverse::Sweep::refined}) {
+                    auto g = outputs[k].gradient(sweep);
+                    expect(eq(g.wrt(x), r.wrt(rx)) && eq(g.wrt(y), r.wrt(ry)));
+                }
+            }
+            if (mode == reverse::Elimination::full) {
+                // only the jacobian is left: each output has one edge per input
+                for (auto const& o : outputs) {
+                    expect(tape.nodes.arity(o.index) == 2UL && tape.trace.ops[o.index] == reverse::Op::statement);
+                }
+                expect(tape.nodes.edges() == 4UL);
+            }
+        }
+    };
+
+    "sharing tapes record repeated subexpressions once"_test = [&]
+    {
+        auto f = [](Tape& tape) {
+            auto x = tape.variable(1.3);
+            auto y = tape.variable(0.6);
+            auto z = tape.variable(0.6);
+            auto a = x * x * x * y + (x * y).sin();
+            auto b = (y * x).sin() * (x * x * x) + 2.0 * y + y * 2.0 + y * 3.0;
+            return std::tuple {x, y, z, a * b + x * x * x};
+        };
+
+        Tape reference;
+        auto [rx, ry, rz, rf] = f(reference);
+
+        Tape tape;
+        tape.sharing = true;
+        tape.recording = true;
+        auto [x, y, z, out] = f(tape);
+        expect(z.index != y.index);  // leaves are never shared
+        expect(tape.length() + 7 == reference.length());
+        expect(tape.trace.size() == tape.length());
+        expect(eq(out.value, rf.value));
+
+        auto r = rf.gradient();
+        for (auto mode : {reverse::Sweep::dense, reverse::Sweep::sparse, reverse::Sweep::cone}) {
+            auto g = out.gradient(mode);
+            expect(eq(g.wrt(x), r.wrt(rx)) && eq(g.wrt(y), r.wrt(ry)));
+        }
+
+        // nodes popped by a rewind are forgotten
+        auto const m = tape.mark();
+        auto const n = tape.length();
+        {
+            Tape::Scope scope {tape};
+            auto u = x.exp();
+            expect(u.index == n && (x.exp()).index == n);
+        }
+        auto v = y * z;
+        auto u = x.exp();
+        expect(v.index == m.nodes && u.index == m.nodes + 1);
+        expect(tape.replay() && eq(tape.value(u.index), std::exp(1.3)));
+
+        // constants are told apart in full precision, even where double would round them together
+        reverse::Tape<long double> wide;
+        wide.sharing = true;
+        auto w = wide.variable(1.0L);
+        auto const c = 1.0L + std::numeric_limits<long double>::epsilon();
+        expect((w + 1.0L).index != (w + c).index);
+        expect((w + c).index == (w + c).index);
+
+        // nan is not equal to anything, itself included, so it is never shared
+        using Table = reverse::Subexpressions<double>;
+        auto const nan = std::numeric_limits<double>::quiet_NaN();
+        expect(!Table::same(nan, 1.0) && !Table::same(1.0, nan) && !Table::same(nan, nan));
+        expect(Table::same(0.5, 0.5) && !Table::same(0.0, -0.0));
+        auto const k = x + 1.0;
+        expect((x + nan).index != k.index && (x + nan).index != (x + nan).index);
+    };
+
+    "worker pool serves repeated calls on the same threads"_test = [&]
+    {
+        reverse::Workers<Tape> workers {3};
+        std::vector<double> out(10);
+        std::vector<std::vector<std::thread::id>> threads;
+        for (auto rows : {10UL, 2UL, 0UL, 10UL}) {
+            std::fill(out.begin(), out.end(), 0.0);
+            std::vector<std::thread::id> ids(rows);
+            workers.run(rows, [&](auto& slot, std::size_t first, std::size_t last) {
+                for (auto i = first; i < last; ++i) {
+                    auto x = slot.tape.variable(static_cast<double>(i));
+                    out[i] = (x * x).gradient().wrt(x);
+                    ids[i] = std::this_thread::get_id();
+                }
+            });
+            for (auto i = 0UL; i < out.size(); ++i) {
+                expect(eq(out[i], i < rows ? 2.0 * static_cast<double>(i) : 0.0));
+            }
+            threads.push_back(ids);
+        }
+        // every chunk goes to the same worker thread on every call
+        expect(threads.front() == threads.back());
+        expect(threads.front()[0] == std::this_thread::get_id() && threads.front()[9] != threads.front()[0]);
+
+        expect(throws<std::runtime_error>([&] {
+            workers.run(6, [](auto& /*slot*/, std::size_t first, std::size_t /*last*/) {
+                if (first > 0) {
+                    throw std::runtime_error("row failed");
+                }
+            });
+        }));
+        auto rows = 0UL;
+        std::mutex m;
+        workers.run(6, [&](auto& /*slot*/, std::size_t first, std::size_t last) {
+            std::scoped_lock lock {m};
+            rows += last - first;
+        });
+        expect(rows == 6UL);
+    };
+
+    "mark, rewind and scoped sub-recordings"_test = [&]
+    {
+        Tape tape;
+        tape.recording = true;
+        auto x = tape.variable(2.0);
+        auto y = tape.variable(3.0);
+        auto const m = tape.mark();
+
+        reverse::Adjoints<double> adjoints;
+        for (auto a : {1.0, 2.0, 3.0}) {
+            Tape::Scope scope {tape};
+            auto f = a * x * y + (y > x ? x.sin() : y.sin());
+            expect(tape.length() > m.nodes);
+
+            for (auto mode : {reverse::Sweep::dense, reverse::Sweep::cone}) {
+                f.gradient_into(adjoints, 1.0, mode, m.nodes);
+                expect(eq(adjoints.wrt(x), a * 3.0 + std::cos(2.0)));
+                expect(eq(adjoints.wrt(y), a * 2.0));
+            }
+        }
+        expect(tape.length() == m.nodes);
+        expect(tape.trace.size() == m.nodes);
+        expect(tape.trace.guards.size() == 0);
+
+        auto z = x * y;
+        expect(tape.length() == z.index + 1);
+        tape.rewind(m);
+        expect(tape.length() == m.nodes && tape.nodes.edges() == 0);
+    };
+
+    "vector-mode reverse sweep fills a column-major jacobian"_test = [&]
+    {
+        Tape tape;
+        std::array x {tape.variable(0.5), tape.variable(4.2)};
+        std::array f {x[0] * x[1], x[0].sin() + x[1], x[1].exp() / x[0]};
+
+        std::array<double, f.size() * x.size()> jacobian {};
+        for (auto mode : {reverse::Sweep::dense, reverse::Sweep::sparse, reverse::Sweep::cone}) {
+            reverse::Adjoints<simd::pack<double, 2>> adjoints;
+            reverse::jacobian_into(f, x, adjoints, jacobian.data(), f.size(), mode);
+
+            for (auto r = 0UL; r < f.size(); ++r) {
+                auto g = f[r].gradient();
+                for (auto c = 0UL; c < x.size(); ++c) {
+                    expect(eq(jacobian[c * f.size() + r], g.wrt(x[c])));
+                }
+            }
+        }
+    };
 };
 
 }  // namespace reverse::test
@@ -2,12 +2,19 @@
 #define REVERSE_AD_DEMO_TEST_NNLS_HPP
 
 #include <iostream>
+#include <memory_resource>
 
 #include <Eigen/Core>
 #include <unsupported/Eigen/LevenbergMarquardt>
 
 #include "ext/boost/ut.hpp"
+#include "reverse-ad-demo/batch.hpp"
+#include "reverse-ad-demo/dual.hpp"
 #include "reverse-ad-demo/expr.hpp"
+#include "reverse-ad-demo/objective.hpp"
+#include "reverse-ad-demo/parallel.hpp"
+#include "reverse-ad-demo/statement.hpp"
+#include "reverse-ad-demo/static_tape.hpp"
 
 namespace reverse::test
 {
@@ -35,49 +42,58 @@ struct thurber_functor
                                       1260.531, 1273.514, 1288.339, 1327.543, 1353.863, 1414.509, 1425.208, 1421.384,
                                       1442.962, 1464.350, 1468.705, 1447.894, 1457.628};
 
-    [[nodiscard]] auto values() const -> int { return xval.size(); }  // NOLINT
-    [[nodiscard]] auto inputs() const -> int { return start1.size(); }  // NOLINT
+    // rational model evaluated at a single data point, beta and x may be variables
+    static auto model(auto const& beta, auto const& x)
+    {
+        auto xx = x * x;
+        auto xxx = x * x * x;
+        return (beta[0] + beta[1] * x + beta[2] * xx + beta[3] * xxx)
+            / (1 + beta[4] * x + beta[5] * xx + beta[6] * xxx);  // NOLINT
+    }
+
+    [[nodiscard]] static auto values() -> int { return xval.size(); }  // NOLINT
+    [[nodiscard]] static auto inputs() -> int { return start1.size(); }  // NOLINT
 
-    auto operator()(Eigen::Matrix<Scalar, -1, 1> const& input, Eigen::Matrix<Scalar, -1, 1>& residual) const -> int
+    auto operator()(Eigen::Matrix<Scalar, -1, 1> const& input, Eigen::Matrix<Scalar, -1, 1>& residual) -> int
     {
         return (*this)(input, residual.data(), static_cast<Scalar*>(nullptr));
     }
 
-    auto df(Eigen::Matrix<Scalar, -1, 1> const& input, Eigen::Matrix<Scalar, -1, -1>& jacobian) const -> int  // NOLINT
+    auto df(Eigen::Matrix<Scalar, -1, 1> const& input, Eigen::Matrix<Scalar, -1, -1>& jacobian) -> int  // NOLINT
     {
         return (*this)(input, static_cast<Scalar*>(nullptr), jacobian.data());
     }
 
   private:
-    auto operator()(auto const& input, auto* residual, auto* jacobian) const -> int  // NOLINT
+    // kept across calls, so the solver's evaluations reuse the tape blocks and
+    // the adjoint workspace instead of allocating them every time
+    reverse::Tape<Scalar> tape;
+    reverse::Adjoints<Scalar> adjoints;
+    std::vector<reverse::Tape<Scalar>::Variable> beta;
+
+    auto operator()(auto const& input, auto* residual, auto* jacobian) -> int  // NOLINT
     {
-        reverse::Tape<Scalar> tape;
-        std::vector<decltype(tape)::Variable> beta;
+        tape.rewind({});
+        beta.clear();
         for (auto v : input) {
             beta.push_back(tape.variable(v));
         }
 
-        for (auto i = 0; i < std::ssize(xval); ++i) {
-            tape.nodes.resize(input.size());
-            for (auto j = 0; j < input.size(); ++j) {
-                beta[j].value = input[j];
-            }
+        auto const start = tape.mark();  // everything before is a parameter
 
-            auto x = xval.at(static_cast<std::size_t>(i));
-            auto xx = x * x;
-            auto xxx = x * x * x;
+        for (auto i = 0; i < std::ssize(xval); ++i) {
+            decltype(tape)::Scope scope {tape};  // pops the residual nodes
 
-            auto f = (beta[0] + beta[1] * x + beta[2] * xx + beta[3] * xxx)
-                / (1 + beta[4] * x + beta[5] * xx + beta[6] * xxx);  // NOLINT
+            auto f = model(beta, xval.at(static_cast<std::size_t>(i)));
 
             if (residual != nullptr) {
                 residual[i] = f.value - yval.at(static_cast<std::size_t>(i));  // NOLINT
             }
 
             if (jacobian != nullptr) {
-                auto g = f.gradient();
+                f.gradient_into(adjoints, 1.0, reverse::Sweep::dense, start.nodes);
                 for (auto const& b : beta) {
-                    jacobian[values() * b.index + i] = g.wrt(b);  // NOLINT
+                    jacobian[values() * b.index + i] = adjoints.wrt(b);  // NOLINT
                 }
             }
         }
@@ -164,11 +180,284 @@ static auto test_thurber()
     return x;
 }
 
+// residuals and jacobian of the tape-based functor at the first starting
+// point, the reference the other evaluation strategies are checked against
+struct thurber_reference
+{
+    Eigen::VectorXd x0;
+    Eigen::VectorXd residual;
+    Eigen::MatrixXd jacobian;
+};
+
+static auto reference_jacobian() -> thurber_reference
+{
+    thurber_functor functor;
+    auto const s1 = thurber_functor::start1;
+    thurber_reference r {Eigen::Map<Eigen::VectorXd const>(s1.data(), std::ssize(s1)),
+                         Eigen::VectorXd(thurber_functor::values()),
+                         Eigen::MatrixXd(thurber_functor::values(), thurber_functor::inputs())};
+    functor(r.x0, r.residual);
+    functor.df(r.x0, r.jacobian);
+    return r;
+}
+
+// records the thurber model once, with x as an input, and replays it for every data point
+static auto test_thurber_replay()
+{
+    auto const s1 = thurber_functor::start1;
+    auto const expected = reference_jacobian().jacobian;
+
+    reverse::Tape<double> tape;
+    tape.recording = true;
+    std::vector<decltype(tape)::Variable> beta;
+    for (auto v : s1) {
+        beta.push_back(tape.variable(v));
+    }
+    auto x = tape.variable(thurber_functor::xval[0]);
+    auto f = thurber_functor::model(beta, x);
+    auto const length = tape.length();
+
+    reverse::Adjoints<double> adjoints;
+    for (auto i = 0; i < thurber_functor::values(); ++i) {
+        tape.set_value(x.index, thurber_functor::xval.at(static_cast<std::size_t>(i)));
+        boost::ut::expect(tape.replay());
+        f.gradient_into(adjoints);
+        for (auto j = 0; j < thurber_functor::inputs(); ++j) {
+            auto const e = expected(i, j);
+            auto const g = adjoints.wrt(beta[static_cast<std::size_t>(j)]);
+            boost::ut::expect(approximately_equal {1e-8}(g / e, 1.0));
+        }
+    }
+    boost::ut::expect(tape.length() == length);  // nothing was re-recorded
+}
+
+// records all residuals on one tape and gets the whole jacobian from vector-mode sweeps
+static auto test_thurber_vector_mode()
+{
+    auto const s1 = thurber_functor::start1;
+    auto const expected = reference_jacobian().jacobian;
+
+    reverse::Tape<double> tape;
+    std::vector<decltype(tape)::Variable> beta;
+    for (auto v : s1) {
+        beta.push_back(tape.variable(v));
+    }
+    std::vector<decltype(tape)::Variable> residuals;
+    for (auto x : thurber_functor::xval) {
+        residuals.push_back(thurber_functor::model(beta, x));
+    }
+
+    Eigen::MatrixXd jacobian(thurber_functor::values(), thurber_functor::inputs());
+    reverse::Adjoints<simd::pack<double, 4>> adjoints;
+    reverse::jacobian_into(residuals, beta, adjoints, jacobian.data(), static_cast<std::size_t>(jacobian.rows()));
+    boost::ut::expect(approximately_equal {1e-12}((jacobian - expected).norm() / expected.norm(), 0.0));
+}
+
+// gradient of the sum of squared residuals, accumulated without a jacobian
+static auto test_thurber_sum_of_squares()
+{
+    auto const s1 = thurber_functor::start1;
+    auto const [x0, residual, jacobian] = reference_jacobian();
+    Eigen::VectorXd const expected = 2 * jacobian.transpose() * residual;
+
+    reverse::Tape<double> tape;
+    reverse::SumOfSquares objective {tape, s1};
+    auto const& beta = objective.parameters;
+    auto peak = tape.length();
+
+    for (auto i = 0; i < thurber_functor::values(); ++i) {
+        auto f = thurber_functor::model(beta, thurber_functor::xval.at(static_cast<std::size_t>(i)));
+        peak = std::max(peak, tape.length());
+        objective.add(f - thurber_functor::yval.at(static_cast<std::size_t>(i)));
+    }
+
+    boost::ut::expect(approximately_equal {1e-8}(objective.value / residual.squaredNorm(), 1.0));
+    for (auto k = 0; k < thurber_functor::inputs(); ++k) {
+        auto const g = objective.gradient[static_cast<std::size_t>(k)];
+        boost::ut::expect(approximately_equal {1e-8}(g / expected[k], 1.0));
+    }
+    boost::ut::expect(tape.length() == beta.size());
+    boost::ut::expect(peak < beta.size() + 32);  // one residual's worth of nodes
+}
+
+// jacobian rows split across worker threads, each with its own tape
+static auto test_thurber_parallel()
+{
+    auto const s1 = thurber_functor::start1;
+    auto const expected = reference_jacobian().jacobian;
+
+    using Tape = reverse::Tape<double>;
+    Eigen::MatrixXd jacobian(thurber_functor::values(), thurber_functor::inputs());
+    reverse::Workers<Tape> workers {4};
+
+    for (auto repeat = 0; repeat < 2; ++repeat) {
+        jacobian.setZero();
+        workers.run(thurber_functor::xval.size(), [&](auto& slot, std::size_t first, std::size_t last) {
+            std::vector<Tape::Variable> beta;
+            for (auto v : s1) {
+                beta.push_back(slot.tape.variable(v));
+            }
+            auto const start = slot.tape.mark();
+
+            for (auto i = first; i < last; ++i) {
+                Tape::Scope scope {slot.tape};
+                auto f = thurber_functor::model(beta, thurber_functor::xval[i]);
+                f.gradient_into(slot.adjoints, 1.0, reverse::Sweep::dense, start.nodes);
+                for (auto j = 0UL; j < beta.size(); ++j) {
+                    jacobian(static_cast<Eigen::Index>(i), static_cast<Eigen::Index>(j)) = slot.adjoints.wrt(beta[j]);
+                }
+            }
+        });
+        boost::ut::expect(approximately_equal {1e-12}((jacobian - expected).norm() / expected.norm(), 0.0));
+    }
+}
+
+// forward-mode jacobian: one evaluation per data point with a lane per parameter
+static auto test_thurber_forward_lanes()
+{
+    auto const s1 = thurber_functor::start1;
+    auto const expected = reference_jacobian().jacobian;
+
+    using Dual = forward::basic_dual<double, s1.size()>;
+    std::array<Dual, s1.size()> beta;
+    for (auto j = 0UL; j < s1.size(); ++j) {
+        beta[j] = Dual::variable(s1[j], j);
+    }
+
+    Eigen::MatrixXd jacobian(thurber_functor::values(), thurber_functor::inputs());
+    for (auto i = 0; i < thurber_functor::values(); ++i) {
+        auto f = thurber_functor::model(beta, thurber_functor::xval.at(static_cast<std::size_t>(i)));
+        for (auto j = 0UL; j < s1.size(); ++j) {
+            jacobian(i, static_cast<Eigen::Index>(j)) = f.b[j];
+        }
+    }
+    boost::ut::expect(approximately_equal {1e-12}((jacobian - expected).norm() / expected.norm(), 0.0));
+}
+
+// memory resource that counts the blocks it hands out
+struct counting_resource : std::pmr::memory_resource
+{
+    std::size_t count {0};
+
+  private:
+    auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override
+    {
+        ++count;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    auto do_deallocate(void* p, std::size_t bytes, std::size_t alignment) -> void override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    [[nodiscard]] auto do_is_equal(std::pmr::memory_resource const& other) const noexcept -> bool override
+    {
+        return this == &other;
+    }
+};
+
+// forward-mode jacobian over the whole data column: one evaluation per parameter
+static auto test_thurber_batch()
+{
+    auto const s1 = thurber_functor::start1;
+    auto const [x0, expected_residual, expected] = reference_jacobian();
+
+    counting_resource upstream;
+    std::pmr::unsynchronized_pool_resource pool {&upstream};
+    using Batch = forward::pmr::batch<double>;
+    auto const x = Batch::constant(thurber_functor::xval, &pool);
+    std::array<forward::dual, s1.size()> beta;
+
+    Eigen::MatrixXd jacobian(thurber_functor::values(), thurber_functor::inputs());
+    for (auto j = 0UL; j < s1.size(); ++j) {
+        for (auto k = 0UL; k < s1.size(); ++k) {
+            beta[k] = {.a = s1[k], .b = k == j ? 1.0 : 0.0};
+        }
+        auto f = thurber_functor::model(beta, x);
+        for (auto i = 0UL; i < f.size(); ++i) {
+            jacobian(static_cast<Eigen::Index>(i), static_cast<Eigen::Index>(j)) = f.b[i];
+            auto const r = f.a[i] - thurber_functor::yval.at(i);
+            boost::ut::expect(approximately_equal {1e-12}(r, expected_residual(static_cast<Eigen::Index>(i))));
+        }
+    }
+    boost::ut::expect(approximately_equal {1e-12}((jacobian - expected).norm() / expected.norm(), 0.0));
+
+    // later evaluations take every column, lvalue operands included, from the pool
+    auto const allocated = upstream.count;
+    boost::ut::expect(thurber_functor::model(beta, x).size() == x.size());
+    boost::ut::expect(upstream.count == allocated);
+}
+
+// the thurber model as a single statement: one tape node per residual
+static auto test_thurber_statement()
+{
+    auto const s1 = thurber_functor::start1;
+    auto const expected = reference_jacobian().jacobian;
+
+    reverse::Tape<double> tape;
+    std::vector<decltype(tape)::Variable> beta;
+    for (auto v : s1) {
+        beta.push_back(tape.variable(v));
+    }
+    auto const start = tape.mark();
+
+    auto b = [&](std::size_t i) { return reverse::lazy(beta[i]); };
+    reverse::Adjoints<double> adjoints;
+    for (auto i = 0; i < thurber_functor::values(); ++i) {
+        decltype(tape)::Scope scope {tape};
+        auto const x = thurber_functor::xval.at(static_cast<std::size_t>(i));
+        auto const xx = x * x;
+        auto const xxx = xx * x;
+        auto f = reverse::evaluate((b(0) + b(1) * x + b(2) * xx + b(3) * xxx)
+                                   / (1 + b(4) * x + b(5) * xx + b(6) * xxx));  // NOLINT
+        boost::ut::expect(tape.length() == start.nodes + 1);
+
+        f.gradient_into(adjoints, 1.0, reverse::Sweep::dense, start.nodes);
+        for (auto j = 0; j < thurber_functor::inputs(); ++j) {
+            auto const g = adjoints.wrt(beta[static_cast<std::size_t>(j)]);
+            boost::ut::expect(approximately_equal {1e-10}(g, expected(i, j)));
+        }
+    }
+}
+
+// the thurber model on a fixed-size tape: parameters plus one residual fit on the stack
+static auto test_thurber_static()
+{
+    auto const s1 = thurber_functor::start1;
+    auto const expected = reference_jacobian().jacobian;
+
+    constexpr auto capacity {24UL};
+    reverse::StaticTape<double, capacity> tape;
+    auto const beta = [&]<std::size_t... k>(std::index_sequence<k...>) {
+        return std::array {tape.variable(s1[k])...};  // braced: recorded in order
+    }(std::make_index_sequence<s1.size()> {});
+    auto const start = tape.mark();
+
+    reverse::StaticAdjoints<double, capacity> adjoints;
+    for (auto i = 0; i < thurber_functor::values(); ++i) {
+        decltype(tape)::Scope scope {tape};
+        auto f = thurber_functor::model(beta, thurber_functor::xval.at(static_cast<std::size_t>(i)));
+        f.gradient_into(adjoints, 1.0, reverse::Sweep::sparse, start.nodes);
+        for (auto j = 0; j < thurber_functor::inputs(); ++j) {
+            auto const g = adjoints.wrt(beta[static_cast<std::size_t>(j)]);
+            boost::ut::expect(approximately_equal {1e-10}(g, expected(i, j)));
+        }
+    }
+    boost::ut::expect(tape.length() == s1.size());
+}
+
 boost::ut::suite const nonlinear_least_squares_test_suite = []() -> void
 {
     using namespace boost::ut;  // NOLINT
 
     "thurber"_test = [&]() -> void { test_thurber(); };
+    "thurber replay"_test = [&]() -> void { test_thurber_replay(); };
+    "thurber vector mode"_test = [&]() -> void { test_thurber_vector_mode(); };
+    "thurber sum of squares"_test = [&]() -> void { test_thurber_sum_of_squares(); };
+    "thurber parallel"_test = [&]() -> void { test_thurber_parallel(); };
+    "thurber forward lanes"_test = [&]() -> void { test_thurber_forward_lanes(); };
+    "thurber batch"_test = [&]() -> void { test_thurber_batch(); };
+    "thurber statement"_test = [&]() -> void { test_thurber_statement(); };
+    "thurber static tape"_test = [&]() -> void { test_thurber_static(); };
 };
 
 }  // namespace reverse::test